@@ -0,0 +1,334 @@
+#include "account_list_layer.h"
+#include "memory.h"
+#include "activity.h"
+
+#define SCROLL_REPEAT_INTERVAL_MS 100
+#define JUMP_REPEAT_INTERVAL_MS 400
+#define SCROLL_ANIMATION_DURATION_MS 150
+
+struct AccountListLayer {
+  Layer *layer;
+  AccountListLayerCallbacks callbacks;
+  void *callback_context;
+  uint16_t num_rows;
+  int32_t *row_offsets;  // Top of each row in content coordinates, num_rows + 1 entries
+  uint16_t selected_row;
+  int32_t scroll_offset;  // Content position shown at the top of the layer
+  Animation *scroll_animation;
+  int32_t scroll_from;
+  int32_t scroll_to;
+  AppTimer *jump_timer;  // Repeats jumps while UP/DOWN is held
+  int8_t jump_direction;
+};
+
+static AccountListLayer* prv_get_list_layer(const Layer *layer) {
+  return *(AccountListLayer**)layer_get_data(layer);
+}
+
+// Last row starting at or above the content position
+static uint16_t prv_row_at(const AccountListLayer *list_layer, int32_t y) {
+  uint16_t low = 0;
+  uint16_t high = list_layer->num_rows;
+  while (high - low > 1) {
+    uint16_t mid = low + (high - low) / 2;
+    if (list_layer->row_offsets[mid] <= y) {
+      low = mid;
+    } else {
+      high = mid;
+    }
+  }
+  return low;
+}
+
+static void prv_layer_update_proc(Layer *layer, GContext *ctx) {
+  AccountListLayer *list_layer = prv_get_list_layer(layer);
+  GRect bounds = layer_get_bounds(layer);
+
+  graphics_context_set_fill_color(ctx, GColorWhite);
+  graphics_fill_rect(ctx, bounds, 0, GCornerNone);
+
+  uint16_t first, last;
+  if (!list_layer->callbacks.draw_row || !account_list_layer_get_visible_rows(list_layer, &first, &last)) {
+    return;
+  }
+  for (uint16_t row = first; row <= last; row++) {
+    list_layer->callbacks.draw_row(ctx, account_list_layer_get_row_frame(list_layer, row), row,
+                                   list_layer->callback_context);
+  }
+}
+
+// ============================================================================
+// Scrolling
+// ============================================================================
+
+// Scroll position that centers the row, without leaving space past the ends
+static int32_t prv_offset_for_row(const AccountListLayer *list_layer, uint16_t row) {
+  int32_t height = layer_get_bounds(list_layer->layer).size.h;
+  int32_t top = list_layer->row_offsets[row];
+  int32_t offset = top + (list_layer->row_offsets[row + 1] - top) / 2 - height / 2;
+#ifndef PBL_ROUND
+  int32_t max_offset = list_layer->row_offsets[list_layer->num_rows] - height;
+  if (offset > max_offset) offset = max_offset;
+  if (offset < 0) offset = 0;
+#endif
+  return offset;
+}
+
+static void prv_scroll_update(Animation *animation, const AnimationProgress progress) {
+  AccountListLayer *list_layer = animation_get_context(animation);
+  list_layer->scroll_offset = list_layer->scroll_from +
+    (list_layer->scroll_to - list_layer->scroll_from) * progress / ANIMATION_NORMALIZED_MAX;
+  layer_mark_dirty(list_layer->layer);
+}
+
+static void prv_scroll_stopped(Animation *animation, bool finished, void *context) {
+  AccountListLayer *list_layer = context;
+  if (list_layer->scroll_animation == animation) {
+    list_layer->scroll_animation = NULL;
+  }
+}
+
+static const AnimationImplementation s_scroll_implementation = {
+  .update = prv_scroll_update,
+};
+
+static void prv_scroll_to(AccountListLayer *list_layer, int32_t offset, bool animated) {
+  if (list_layer->scroll_animation) {
+    animation_unschedule(list_layer->scroll_animation);
+    list_layer->scroll_animation = NULL;
+  }
+
+  if (animated && offset != list_layer->scroll_offset) {
+    Animation *animation = animation_create();
+    if (animation) {
+      list_layer->scroll_from = list_layer->scroll_offset;
+      list_layer->scroll_to = offset;
+      animation_set_duration(animation, SCROLL_ANIMATION_DURATION_MS);
+      animation_set_curve(animation, AnimationCurveEaseOut);
+      animation_set_implementation(animation, &s_scroll_implementation);
+      animation_set_handlers(animation, (AnimationHandlers){ .stopped = prv_scroll_stopped }, list_layer);
+      list_layer->scroll_animation = animation;
+      animation_schedule(animation);
+      return;
+    }
+  }
+  list_layer->scroll_offset = offset;
+  layer_mark_dirty(list_layer->layer);
+}
+
+// ============================================================================
+// Click handling
+// ============================================================================
+
+static void prv_move_selection(AccountListLayer *list_layer, int direction) {
+  activity_note();  // Presses past the list ends count too
+  if (list_layer->num_rows == 0) return;
+
+  uint16_t old_row = list_layer->selected_row;
+  if (direction < 0 && old_row == 0) return;
+  if (direction > 0 && old_row + 1 >= list_layer->num_rows) return;
+
+  account_list_layer_set_selected_row(list_layer, old_row + direction, true);
+}
+
+static void prv_up_click_handler(ClickRecognizerRef recognizer, void *context) {
+  prv_move_selection((AccountListLayer*)context, -1);
+}
+
+static void prv_down_click_handler(ClickRecognizerRef recognizer, void *context) {
+  prv_move_selection((AccountListLayer*)context, 1);
+}
+
+static void prv_jump(AccountListLayer *list_layer, int direction) {
+  activity_note();
+  if (list_layer->num_rows == 0 || !list_layer->callbacks.get_jump_row) return;
+
+  uint16_t row = list_layer->callbacks.get_jump_row(list_layer->selected_row, direction, list_layer->callback_context);
+  account_list_layer_set_selected_row(list_layer, row, true);
+}
+
+static void prv_cancel_jump_repeat(AccountListLayer *list_layer) {
+  if (list_layer->jump_timer) {
+    app_timer_cancel(list_layer->jump_timer);
+    list_layer->jump_timer = NULL;
+  }
+}
+
+static void prv_jump_repeat_callback(void *data) {
+  AccountListLayer *list_layer = (AccountListLayer*)data;
+  prv_jump(list_layer, list_layer->jump_direction);
+  list_layer->jump_timer = app_timer_register(JUMP_REPEAT_INTERVAL_MS, prv_jump_repeat_callback, list_layer);
+}
+
+// The first jump happens on the long press, more follow until the button is released
+static void prv_start_jump_repeat(AccountListLayer *list_layer, int direction) {
+  prv_cancel_jump_repeat(list_layer);
+  list_layer->jump_direction = direction;
+  prv_jump(list_layer, direction);
+  list_layer->jump_timer = app_timer_register(JUMP_REPEAT_INTERVAL_MS, prv_jump_repeat_callback, list_layer);
+}
+
+static void prv_up_long_click_handler(ClickRecognizerRef recognizer, void *context) {
+  prv_start_jump_repeat((AccountListLayer*)context, -1);
+}
+
+static void prv_down_long_click_handler(ClickRecognizerRef recognizer, void *context) {
+  prv_start_jump_repeat((AccountListLayer*)context, 1);
+}
+
+static void prv_long_click_release_handler(ClickRecognizerRef recognizer, void *context) {
+  prv_cancel_jump_repeat((AccountListLayer*)context);
+}
+
+static void prv_select_click_handler(ClickRecognizerRef recognizer, void *context) {
+  AccountListLayer *list_layer = (AccountListLayer*)context;
+  activity_note();
+  if (list_layer->callbacks.select_click) {
+    list_layer->callbacks.select_click(list_layer->selected_row, list_layer->callback_context);
+  }
+}
+
+static void prv_select_long_click_handler(ClickRecognizerRef recognizer, void *context) {
+  AccountListLayer *list_layer = (AccountListLayer*)context;
+  activity_note();
+  if (list_layer->num_rows > 0 && list_layer->callbacks.select_long_click) {
+    list_layer->callbacks.select_long_click(list_layer->selected_row, list_layer->callback_context);
+  }
+}
+
+static void prv_click_config_provider(void *context) {
+  AccountListLayer *list_layer = (AccountListLayer*)context;
+  
+  // Holding a button repeats row steps, or jumps when jump rows are provided
+  if (list_layer->callbacks.get_jump_row) {
+    window_single_click_subscribe(BUTTON_ID_UP, prv_up_click_handler);
+    window_single_click_subscribe(BUTTON_ID_DOWN, prv_down_click_handler);
+    window_long_click_subscribe(BUTTON_ID_UP, 0, prv_up_long_click_handler, prv_long_click_release_handler);
+    window_long_click_subscribe(BUTTON_ID_DOWN, 0, prv_down_long_click_handler, prv_long_click_release_handler);
+  } else {
+    window_single_repeating_click_subscribe(BUTTON_ID_UP, SCROLL_REPEAT_INTERVAL_MS, prv_up_click_handler);
+    window_single_repeating_click_subscribe(BUTTON_ID_DOWN, SCROLL_REPEAT_INTERVAL_MS, prv_down_click_handler);
+  }
+  window_single_click_subscribe(BUTTON_ID_SELECT, prv_select_click_handler);
+  window_long_click_subscribe(BUTTON_ID_SELECT, 0, prv_select_long_click_handler, NULL);
+}
+
+// ============================================================================
+// Public API
+// ============================================================================
+
+AccountListLayer* account_list_layer_create(GRect frame) {
+  AccountListLayer *list_layer = memory_malloc(sizeof(AccountListLayer));
+  if (!list_layer) return NULL;
+  memset(list_layer, 0, sizeof(AccountListLayer));
+
+  list_layer->layer = layer_create_with_data(frame, sizeof(AccountListLayer*));
+  if (!list_layer->layer) {
+    memory_free(list_layer);
+    return NULL;
+  }
+  *(AccountListLayer**)layer_get_data(list_layer->layer) = list_layer;
+  layer_set_update_proc(list_layer->layer, prv_layer_update_proc);
+
+  return list_layer;
+}
+
+void account_list_layer_destroy(AccountListLayer *list_layer) {
+  if (!list_layer) return;
+
+  if (list_layer->scroll_animation) {
+    animation_unschedule(list_layer->scroll_animation);
+    list_layer->scroll_animation = NULL;
+  }
+  prv_cancel_jump_repeat(list_layer);
+  if (list_layer->row_offsets) {
+    memory_free(list_layer->row_offsets);
+  }
+  if (list_layer->layer) {
+    layer_destroy(list_layer->layer);
+  }
+  memory_free(list_layer);
+}
+
+Layer* account_list_layer_get_layer(AccountListLayer *list_layer) {
+  return list_layer ? list_layer->layer : NULL;
+}
+
+void account_list_layer_set_callbacks(AccountListLayer *list_layer, void *context, AccountListLayerCallbacks callbacks) {
+  if (!list_layer) return;
+  list_layer->callback_context = context;
+  list_layer->callbacks = callbacks;
+}
+
+void account_list_layer_set_click_config_onto_window(AccountListLayer *list_layer, Window *window) {
+  if (!list_layer || !window) return;
+  window_set_click_config_provider_with_context(window, prv_click_config_provider, list_layer);
+}
+
+void account_list_layer_reload_data(AccountListLayer *list_layer) {
+  if (!list_layer) return;
+
+  if (list_layer->row_offsets) {
+    memory_free(list_layer->row_offsets);
+    list_layer->row_offsets = NULL;
+  }
+  list_layer->num_rows = 0;
+
+  uint16_t num_rows = list_layer->callbacks.get_num_rows ?
+    list_layer->callbacks.get_num_rows(list_layer->callback_context) : 0;
+  list_layer->row_offsets = memory_malloc((num_rows + 1) * sizeof(int32_t));
+  if (!list_layer->row_offsets) {
+    APP_LOG(APP_LOG_LEVEL_ERROR, "Out of memory");
+    layer_mark_dirty(list_layer->layer);
+    return;
+  }
+
+  list_layer->row_offsets[0] = 0;
+  for (uint16_t row = 0; row < num_rows; row++) {
+    list_layer->row_offsets[row + 1] = list_layer->row_offsets[row] +
+      list_layer->callbacks.get_row_height(row, list_layer->callback_context);
+  }
+  list_layer->num_rows = num_rows;
+
+  // Keep the selection if it still exists
+  if (list_layer->selected_row >= num_rows) {
+    list_layer->selected_row = num_rows > 0 ? num_rows - 1 : 0;
+  }
+  prv_scroll_to(list_layer, num_rows > 0 ? prv_offset_for_row(list_layer, list_layer->selected_row) : 0, false);
+}
+
+uint16_t account_list_layer_get_selected_row(const AccountListLayer *list_layer) {
+  return list_layer ? list_layer->selected_row : 0;
+}
+
+void account_list_layer_set_selected_row(AccountListLayer *list_layer, uint16_t row, bool animated) {
+  if (!list_layer || row >= list_layer->num_rows) return;
+
+  uint16_t old_row = list_layer->selected_row;
+  list_layer->selected_row = row;
+  if (row != old_row && list_layer->callbacks.selection_changed) {
+    list_layer->callbacks.selection_changed(row, old_row, list_layer->callback_context);
+  }
+  prv_scroll_to(list_layer, prv_offset_for_row(list_layer, row), animated);
+}
+
+bool account_list_layer_get_visible_rows(const AccountListLayer *list_layer, uint16_t *first, uint16_t *last) {
+  if (!list_layer || list_layer->num_rows == 0) return false;
+
+  int32_t top = list_layer->scroll_offset;
+  int32_t bottom = top + layer_get_bounds(list_layer->layer).size.h - 1;
+  if (bottom < 0 || top >= list_layer->row_offsets[list_layer->num_rows]) return false;
+
+  *first = prv_row_at(list_layer, top);
+  *last = prv_row_at(list_layer, bottom);
+  return true;
+}
+
+GRect account_list_layer_get_row_frame(const AccountListLayer *list_layer, uint16_t row) {
+  if (!list_layer || row >= list_layer->num_rows) return GRectZero;
+
+  int32_t top = list_layer->row_offsets[row];
+  return GRect(0, top - list_layer->scroll_offset,
+               layer_get_bounds(list_layer->layer).size.w,
+               list_layer->row_offsets[row + 1] - top);
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <pebble.h>
+
+// Vertical list that only draws the rows on screen. Row offsets are kept
+// in a prefix-sum table, so finding the row at a position takes a binary
+// search and scrolling to a row doesn't depend on the number of rows.
+typedef struct AccountListLayer AccountListLayer;
+
+typedef struct {
+  uint16_t (*get_num_rows)(void *context);
+  int16_t (*get_row_height)(uint16_t row, void *context);
+  // frame is the row's rectangle in the layer's coordinates
+  void (*draw_row)(GContext *ctx, GRect frame, uint16_t row, void *context);
+  void (*select_click)(uint16_t row, void *context);
+  void (*select_long_click)(uint16_t row, void *context);
+  void (*selection_changed)(uint16_t new_row, uint16_t old_row, void *context);
+  // Optional, row to jump to on a long UP (direction -1) or DOWN (1) press.
+  // Holding UP/DOWN then repeats jumps instead of row steps.
+  uint16_t (*get_jump_row)(uint16_t row, int direction, void *context);
+} AccountListLayerCallbacks;
+
+AccountListLayer* account_list_layer_create(GRect frame);
+void account_list_layer_destroy(AccountListLayer *list_layer);
+Layer* account_list_layer_get_layer(AccountListLayer *list_layer);
+void account_list_layer_set_callbacks(AccountListLayer *list_layer, void *context, AccountListLayerCallbacks callbacks);
+void account_list_layer_set_click_config_onto_window(AccountListLayer *list_layer, Window *window);
+
+// Rebuild the row offsets after rows were added, removed or resized
+void account_list_layer_reload_data(AccountListLayer *list_layer);
+
+uint16_t account_list_layer_get_selected_row(const AccountListLayer *list_layer);
+void account_list_layer_set_selected_row(AccountListLayer *list_layer, uint16_t row, bool animated);
+
+// Range of rows at least partly on screen, false if there are none
+bool account_list_layer_get_visible_rows(const AccountListLayer *list_layer, uint16_t *first, uint16_t *last);
+
+// Rectangle of a row in the layer's coordinates, may be off screen
+GRect account_list_layer_get_row_frame(const AccountListLayer *list_layer, uint16_t row);
@@ -0,0 +1,137 @@
+#include "activity.h"
+#include "storage.h"
+#include <string.h>
+
+// The list and the pinned code window
+#define ACTIVITY_MAX_LISTENERS 2
+
+typedef struct {
+  ActivityChangedHandler handler;
+  void *context;
+} ActivityListener;
+
+static ActivityListener s_listeners[ACTIVITY_MAX_LISTENERS];
+static AppTimer *s_idle_timer = NULL;
+static AppTimer *s_exit_timer = NULL;
+static uint16_t s_idle_seconds = 0;  // 0 never
+static uint16_t s_exit_seconds = 0;  // 0 never
+static bool s_idle = false;  // No buttons pressed for a while
+static bool s_paused = false;  // Something else has the focus
+
+static void prv_notify(void) {
+  for (int i = 0; i < ACTIVITY_MAX_LISTENERS; i++) {
+    if (s_listeners[i].handler) {
+      s_listeners[i].handler(s_listeners[i].context);
+    }
+  }
+}
+
+// ============================================================================
+// Timeouts
+// ============================================================================
+
+static void prv_idle_timer_callback(void *data) {
+  s_idle_timer = NULL;
+  s_idle = true;
+  prv_notify();
+}
+
+static void prv_exit_timer_callback(void *data) {
+  s_exit_timer = NULL;
+  APP_LOG(APP_LOG_LEVEL_INFO, "No input for %d s, exiting", s_exit_seconds);
+  window_stack_pop_all(false);
+}
+
+static void prv_restart_timer(AppTimer **timer, uint16_t seconds, AppTimerCallback callback) {
+  if (seconds == 0) {
+    if (*timer) {
+      app_timer_cancel(*timer);
+      *timer = NULL;
+    }
+    return;
+  }
+  if (!*timer || !app_timer_reschedule(*timer, seconds * 1000)) {
+    *timer = app_timer_register(seconds * 1000, callback, NULL);
+  }
+}
+
+// ============================================================================
+// App focus
+// ============================================================================
+
+static void prv_app_will_focus(bool in_focus) {
+  if (!in_focus) {
+    // Pause before the notification slides in
+    s_paused = true;
+    vibes_cancel();
+    prv_notify();
+  }
+}
+
+static void prv_app_did_focus(bool in_focus) {
+  if (in_focus && s_paused) {
+    s_paused = false;
+    prv_notify();
+  }
+}
+
+// ============================================================================
+// Public API
+// ============================================================================
+
+void activity_init(void) {
+  app_focus_service_subscribe_handlers((AppFocusHandlers){
+    .will_focus = prv_app_will_focus,
+    .did_focus = prv_app_did_focus,
+  });
+  activity_set_timeouts(storage_get_idle_seconds(), storage_get_exit_seconds());
+}
+
+void activity_deinit(void) {
+  prv_restart_timer(&s_idle_timer, 0, NULL);
+  prv_restart_timer(&s_exit_timer, 0, NULL);
+  app_focus_service_unsubscribe();
+  memset(s_listeners, 0, sizeof(s_listeners));
+}
+
+void activity_note(void) {
+  prv_restart_timer(&s_idle_timer, s_idle_seconds, prv_idle_timer_callback);
+  prv_restart_timer(&s_exit_timer, s_exit_seconds, prv_exit_timer_callback);
+  if (s_idle) {
+    s_idle = false;
+    prv_notify();
+  }
+}
+
+void activity_set_timeouts(uint16_t idle_seconds, uint16_t exit_seconds) {
+  s_idle_seconds = idle_seconds;
+  s_exit_seconds = exit_seconds;
+  activity_note();
+}
+
+bool activity_is_idle(void) {
+  return s_idle;
+}
+
+bool activity_is_paused(void) {
+  return s_paused;
+}
+
+bool activity_subscribe(ActivityChangedHandler handler, void *context) {
+  for (int i = 0; i < ACTIVITY_MAX_LISTENERS; i++) {
+    if (!s_listeners[i].handler) {
+      s_listeners[i] = (ActivityListener){ .handler = handler, .context = context };
+      return true;
+    }
+  }
+  APP_LOG(APP_LOG_LEVEL_WARNING, "No free activity listener slot");
+  return false;
+}
+
+void activity_unsubscribe(ActivityChangedHandler handler, void *context) {
+  for (int i = 0; i < ACTIVITY_MAX_LISTENERS; i++) {
+    if (s_listeners[i].handler == handler && s_listeners[i].context == context) {
+      s_listeners[i] = (ActivityListener){ 0 };
+    }
+  }
+}
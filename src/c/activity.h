@@ -0,0 +1,34 @@
+#pragma once
+
+#include <pebble.h>
+
+// App-wide idle policy. Nothing should refresh while a notification or
+// another app has the focus. Without button presses the app goes idle
+// after the idle timeout, windows then refresh in low power without
+// countdown vibrations, and it exits after the exit timeout, so a
+// forgotten app doesn't keep the watch busy. Every click handler reports
+// its button press with activity_note().
+
+// Called when the app goes idle, wakes up, loses or regains the focus
+typedef void (*ActivityChangedHandler)(void *context);
+
+// Subscribes to the app focus and starts the timeouts from storage
+void activity_init(void);
+void activity_deinit(void);
+
+// A button was pressed, restarts the timeouts and wakes the app up
+void activity_note(void);
+
+// Seconds without button presses until idle and until the app exits,
+// 0 for never
+void activity_set_timeouts(uint16_t idle_seconds, uint16_t exit_seconds);
+
+bool activity_is_idle(void);
+
+// Something else has the focus
+bool activity_is_paused(void);
+
+// Windows showing codes listen while they are loaded, false if all
+// ACTIVITY_MAX_LISTENERS slots are taken
+bool activity_subscribe(ActivityChangedHandler handler, void *context);
+void activity_unsubscribe(ActivityChangedHandler handler, void *context);
@@ -0,0 +1,68 @@
+#include "code_renderer.h"
+
+#define GLYPH_COUNT 11  // 0-9 and the dash placeholder
+#define GLYPH_DASH 10
+
+static GBitmap *s_atlas = NULL;
+static GBitmap *s_glyphs[GLYPH_COUNT];
+
+static int prv_glyph_index(char c) {
+  if (c >= '0' && c <= '9') return c - '0';
+  if (c == '-') return GLYPH_DASH;
+  return -1;
+}
+
+bool code_renderer_init(void) {
+  if (s_atlas) return true;
+
+  s_atlas = gbitmap_create_with_resource(RESOURCE_ID_DIGITS);
+  if (!s_atlas) {
+    APP_LOG(APP_LOG_LEVEL_ERROR, "Failed to load digit atlas");
+    return false;
+  }
+
+  // Sub-bitmaps share the atlas pixels, only their headers are allocated
+  for (int i = 0; i < GLYPH_COUNT; i++) {
+    s_glyphs[i] = gbitmap_create_as_sub_bitmap(s_atlas,
+      GRect(i * DIGIT_GLYPH_WIDTH, 0, DIGIT_GLYPH_WIDTH, DIGIT_GLYPH_HEIGHT));
+    if (!s_glyphs[i]) {
+      code_renderer_deinit();
+      return false;
+    }
+  }
+  return true;
+}
+
+void code_renderer_deinit(void) {
+  for (int i = 0; i < GLYPH_COUNT; i++) {
+    if (s_glyphs[i]) {
+      gbitmap_destroy(s_glyphs[i]);
+      s_glyphs[i] = NULL;
+    }
+  }
+  if (s_atlas) {
+    gbitmap_destroy(s_atlas);
+    s_atlas = NULL;
+  }
+}
+
+bool code_renderer_draw(GContext *ctx, const char *code, GRect rect) {
+  if (!s_atlas) return false;
+
+  size_t len = 0;
+  for (const char *c = code; *c; c++, len++) {
+    if (prv_glyph_index(*c) < 0) return false;
+  }
+  if (len == 0) return false;
+
+  int16_t width = len * DIGIT_GLYPH_WIDTH + (len - 1) * DIGIT_GLYPH_SPACING;
+  int16_t x = rect.origin.x + (rect.size.w - width) / 2;
+  int16_t y = rect.origin.y + (rect.size.h - DIGIT_GLYPH_HEIGHT) / 2;
+
+  for (const char *c = code; *c; c++) {
+    graphics_draw_bitmap_in_rect(ctx, s_glyphs[prv_glyph_index(*c)],
+                                 GRect(x, y, DIGIT_GLYPH_WIDTH, DIGIT_GLYPH_HEIGHT));
+    x += DIGIT_GLYPH_WIDTH + DIGIT_GLYPH_SPACING;
+  }
+  return true;
+}
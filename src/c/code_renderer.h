@@ -0,0 +1,18 @@
+#pragma once
+
+#include <pebble.h>
+
+// Codes are drawn by blitting fixed-width glyphs from a bitmap atlas
+// (resources/images/digits.png, generated by tools/gen_digits.py)
+// instead of laying out text
+#define DIGIT_GLYPH_WIDTH 15
+#define DIGIT_GLYPH_HEIGHT 21
+#define DIGIT_GLYPH_SPACING 1
+
+// Load the glyph atlas, false if out of memory
+bool code_renderer_init(void);
+void code_renderer_deinit(void);
+
+// Draw a code of digits and dashes centered in rect. Returns false without
+// drawing if the code has other characters or the atlas isn't loaded.
+bool code_renderer_draw(GContext *ctx, const char *code, GRect rect);
@@ -0,0 +1,226 @@
+#include "code_window.h"
+#include "code_renderer.h"
+#include "memory.h"
+#include "activity.h"
+
+#define COUNTDOWN_BAR_HEIGHT 4
+#define COUNTDOWN_BAR_INSET 10
+
+struct CodeWindow {
+  Window *window;
+  Layer *layer;
+  AppTimer *timer;
+  TotpAccount account;
+  char code[MAX_DIGITS + 1];
+  uint64_t counter;  // Time step the code was generated for
+  uint32_t remaining;
+  bool code_valid;
+  CodeWindowCallbacks callbacks;
+  void *callback_context;
+};
+
+// ============================================================================
+// Code updates
+// ============================================================================
+
+static void prv_timer_callback(void *data);
+
+static uint32_t prv_period(CodeWindow *code_window) {
+  return code_window->account.period > 0 ? code_window->account.period : DEFAULT_PERIOD;
+}
+
+// The code is only generated again when the time step changes
+static void prv_update(CodeWindow *code_window) {
+  time_t now = time(NULL);
+  uint32_t period = prv_period(code_window);
+  code_window->remaining = period - (uint32_t)(now % period);
+  if (!code_window->code_valid || code_window->counter != (uint64_t)(now / period)) {
+    code_window->code_valid = totp_generate(&code_window->account, now, code_window->code,
+                                            sizeof(code_window->code), &code_window->counter);
+  }
+  if (code_window->layer) {
+    layer_mark_dirty(code_window->layer);
+  }
+
+  // Nothing runs while paused, idle only wakes for the next code
+  if (activity_is_paused()) return;
+  uint32_t seconds = activity_is_idle() ? code_window->remaining : 1;
+
+  // Wake just after the second changes
+  uint32_t delay = seconds * 1000 - time_ms(NULL, NULL) + 10;
+  code_window->timer = app_timer_register(delay, prv_timer_callback, code_window);
+}
+
+static void prv_timer_callback(void *data) {
+  CodeWindow *code_window = (CodeWindow*)data;
+  code_window->timer = NULL;
+  prv_update(code_window);
+}
+
+static void prv_stop_updates(CodeWindow *code_window) {
+  if (code_window->timer) {
+    app_timer_cancel(code_window->timer);
+    code_window->timer = NULL;
+  }
+}
+
+// Same policy as the list, see activity.h
+static void prv_activity_changed(void *context) {
+  CodeWindow *code_window = (CodeWindow*)context;
+  prv_stop_updates(code_window);
+  if (!activity_is_paused()) {
+    prv_update(code_window);
+  }
+}
+
+// ============================================================================
+// Drawing
+// ============================================================================
+
+static void prv_layer_update_proc(Layer *layer, GContext *ctx) {
+  CodeWindow *code_window = *(CodeWindow**)layer_get_data(layer);
+  GRect bounds = layer_get_bounds(layer);
+  int16_t y = bounds.size.h / 2 - 56;
+
+  graphics_context_set_text_color(ctx, GColorBlack);
+  graphics_draw_text(ctx, code_window->account.label, fonts_get_system_font(FONT_KEY_GOTHIC_24_BOLD),
+                     GRect(4, y, bounds.size.w - 8, 28),
+                     GTextOverflowModeTrailingEllipsis, GTextAlignmentCenter, NULL);
+  y += 26;
+
+  if (code_window->account.account_name[0] != '\0') {
+    graphics_draw_text(ctx, code_window->account.account_name, fonts_get_system_font(FONT_KEY_GOTHIC_18),
+                       GRect(4, y, bounds.size.w - 8, 22),
+                       GTextOverflowModeTrailingEllipsis, GTextAlignmentCenter, NULL);
+  }
+  y += 24;
+
+  const char *code_text = code_window->code_valid ? code_window->code : "------";
+  GRect code_frame = GRect(0, y, bounds.size.w, 34);
+  if (!code_renderer_draw(ctx, code_text, code_frame)) {
+    graphics_draw_text(ctx, code_text, fonts_get_system_font(FONT_KEY_GOTHIC_28_BOLD), code_frame,
+                       GTextOverflowModeTrailingEllipsis, GTextAlignmentCenter, NULL);
+  }
+  y += 40;
+
+  int16_t bar_width = bounds.size.w - 2 * COUNTDOWN_BAR_INSET;
+  int16_t width = code_window->remaining * bar_width / prv_period(code_window);
+  graphics_context_set_fill_color(ctx, GColorBlack);
+  graphics_fill_rect(ctx, GRect(COUNTDOWN_BAR_INSET, y, width, COUNTDOWN_BAR_HEIGHT), 0, GCornerNone);
+}
+
+// ============================================================================
+// Click handling
+// ============================================================================
+
+static void prv_back_click_handler(ClickRecognizerRef recognizer, void *context) {
+  CodeWindow *code_window = (CodeWindow*)context;
+  activity_note();
+  if (code_window->callbacks.back) {
+    code_window->callbacks.back(code_window->callback_context);
+  } else {
+    window_stack_remove(code_window->window, true);
+  }
+}
+
+// The other buttons do nothing but keep the window from timing out
+static void prv_activity_click_handler(ClickRecognizerRef recognizer, void *context) {
+  activity_note();
+}
+
+static void prv_click_config_provider(void *context) {
+  window_single_click_subscribe(BUTTON_ID_BACK, prv_back_click_handler);
+  window_single_click_subscribe(BUTTON_ID_UP, prv_activity_click_handler);
+  window_single_click_subscribe(BUTTON_ID_SELECT, prv_activity_click_handler);
+  window_single_click_subscribe(BUTTON_ID_DOWN, prv_activity_click_handler);
+}
+
+// ============================================================================
+// Window lifecycle
+// ============================================================================
+
+static void prv_window_load(Window *window) {
+  CodeWindow *code_window = (CodeWindow*)window_get_user_data(window);
+  Layer *window_layer = window_get_root_layer(window);
+
+  // The atlas is shared with the list and freed by ui_deinit
+  code_renderer_init();
+
+  code_window->layer = layer_create_with_data(layer_get_bounds(window_layer), sizeof(CodeWindow*));
+  *(CodeWindow**)layer_get_data(code_window->layer) = code_window;
+  layer_set_update_proc(code_window->layer, prv_layer_update_proc);
+  layer_add_child(window_layer, code_window->layer);
+
+  activity_subscribe(prv_activity_changed, code_window);
+  prv_update(code_window);
+}
+
+static void prv_window_unload(Window *window) {
+  CodeWindow *code_window = (CodeWindow*)window_get_user_data(window);
+  activity_unsubscribe(prv_activity_changed, code_window);
+  prv_stop_updates(code_window);
+
+  if (code_window->layer) {
+    layer_destroy(code_window->layer);
+    code_window->layer = NULL;
+  }
+  if (code_window->callbacks.unload) {
+    code_window->callbacks.unload(code_window->callback_context);
+  }
+}
+
+// ============================================================================
+// Public API
+// ============================================================================
+
+CodeWindow* code_window_create(const TotpAccount *account, CodeWindowCallbacks callbacks, void *context) {
+  if (!account) return NULL;
+
+  CodeWindow *code_window = memory_malloc(sizeof(CodeWindow));
+  if (!code_window) return NULL;
+
+  memset(code_window, 0, sizeof(CodeWindow));
+  code_window->account = *account;
+  code_window->callbacks = callbacks;
+  code_window->callback_context = context;
+
+  code_window->window = window_create();
+  if (!code_window->window) {
+    code_window_destroy(code_window);
+    return NULL;
+  }
+
+  window_set_background_color(code_window->window, GColorWhite);
+  window_set_user_data(code_window->window, code_window);
+  window_set_click_config_provider_with_context(code_window->window, prv_click_config_provider, code_window);
+  window_set_window_handlers(code_window->window, (WindowHandlers){
+    .load = prv_window_load,
+    .unload = prv_window_unload,
+  });
+  return code_window;
+}
+
+void code_window_destroy(CodeWindow *code_window) {
+  if (!code_window) return;
+
+  prv_stop_updates(code_window);
+  if (code_window->window) {
+    window_destroy(code_window->window);
+  }
+
+  // Don't leave the secret behind on the heap
+  memset(code_window, 0, sizeof(CodeWindow));
+  memory_free(code_window);
+}
+
+void code_window_push(CodeWindow *code_window, bool animated) {
+  if (code_window && code_window->window) {
+    window_stack_push(code_window->window, animated);
+  }
+}
+
+void code_window_remove(CodeWindow *code_window, bool animated) {
+  if (code_window && code_window->window) {
+    window_stack_remove(code_window->window, animated);
+  }
+}
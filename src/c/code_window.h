@@ -0,0 +1,27 @@
+#pragma once
+
+#include <pebble.h>
+#include "totp.h"
+
+// Full-screen code of a single account, shown on launch for the pinned
+// account without loading the rest of the list
+typedef struct CodeWindow CodeWindow;
+
+typedef struct {
+  // BACK was pressed, the window is left on the stack for the handler
+  void (*back)(void *context);
+  // The window left the stack, destroy it from a later event
+  void (*unload)(void *context);
+} CodeWindowCallbacks;
+
+// Create code window with a copy of the account
+CodeWindow* code_window_create(const TotpAccount *account, CodeWindowCallbacks callbacks, void *context);
+
+// Destroy code window, the account copy is wiped
+void code_window_destroy(CodeWindow *code_window);
+
+// Push code window
+void code_window_push(CodeWindow *code_window, bool animated);
+
+// Remove code window from the stack
+void code_window_remove(CodeWindow *code_window, bool animated);
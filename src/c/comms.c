@@ -2,12 +2,21 @@
 #include "ui.h"
 #include "totp.h"
 #include "storage.h"
+#include "profile.h"
+#include "diagnostics.h"
+#include "trace.h"
+#include "memory.h"
 #include "message_keys.auto.h"
 #include <string.h>
 
+#define SYNC_STATUS_OK 1
+#define SYNC_STATUS_NO_SPACE 2
+#define SYNC_STATUS_INVALID 3  // An entry couldn't be parsed
+
 // Sync state
 static size_t s_sync_expected_count = 0;
 static size_t s_sync_received_count = 0;
+static bool s_sync_active = false;  // Begun and not committed yet
 
 static void prv_request_sync(void) {
   DictionaryIterator *iter = NULL;
@@ -17,6 +26,7 @@ static void prv_request_sync(void) {
     return;
   }
   dict_write_uint8(iter, MESSAGE_KEY_AppKeyRequest, 1);
+  TRACE_INSTANT(TRACE_MESSAGE_OUT, MESSAGE_KEY_AppKeyRequest);
   res = app_message_outbox_send();
   if (res != APP_MSG_OK) {
     APP_LOG(APP_LOG_LEVEL_WARNING, "Failed to send request: %d", res);
@@ -29,116 +39,76 @@ static void prv_send_status(uint8_t status_code) {
     return;
   }
   dict_write_uint8(iter, MESSAGE_KEY_AppKeyStatus, status_code);
+  TRACE_INSTANT(TRACE_MESSAGE_OUT, MESSAGE_KEY_AppKeyStatus);
   app_message_outbox_send();
 }
 
+static void prv_trim(char *str) {
+  if (!str) return;
+  char *trim_ptr = str;
+  while (*trim_ptr == ' ' || *trim_ptr == '\t') trim_ptr++;
+  memmove(str, trim_ptr, strlen(trim_ptr) + 1);
+  trim_ptr = str + strlen(str) - 1;
+  while (trim_ptr >= str && (*trim_ptr == ' ' || *trim_ptr == '\t')) {
+    *trim_ptr = '\0';
+    trim_ptr--;
+  }
+}
+
+// Split off the next '|' separated field, NULL if there is none
+static char *prv_next_field(char *field) {
+  if (!field) return NULL;
+  char *next = strchr(field, '|');
+  if (next) {
+    *next = '\0';
+    next++;
+  }
+  return next;
+}
+
+static uint64_t prv_parse_u64(const char *str) {
+  uint64_t value = 0;
+  while (*str >= '0' && *str <= '9') {
+    value = value * 10 + (uint64_t)(*str - '0');
+    str++;
+  }
+  return value;
+}
+
+// Line format: label|account_name|secret[|period[|digits[|algorithm[|type[|counter]]]]]
 static bool prv_parse_line(const char *line, TotpAccount *out_account) {
   if (!line || !out_account) {
     return false;
   }
 
-  char buffer[SECRET_BASE32_MAX_LEN + LABEL_MAX_LEN + ACCOUNT_NAME_MAX_LEN + 32];
+  char buffer[SECRET_BASE32_MAX_LEN + LABEL_MAX_LEN + ACCOUNT_NAME_MAX_LEN + 64];
   strncpy(buffer, line, sizeof(buffer) - 1);
   buffer[sizeof(buffer) - 1] = '\0';
 
   char *label = buffer;
-  char *account_name = strchr(buffer, '|');
+  char *account_name = prv_next_field(label);
   if (!account_name) {
     return false;
   }
-  *account_name = '\0';
-  account_name++;
-
-  char *secret = strchr(account_name, '|');
+  char *secret = prv_next_field(account_name);
   if (!secret) {
     return false;
   }
-  *secret = '\0';
-  secret++;
-
-  char *period_str = strchr(secret, '|');
-  if (period_str) {
-    *period_str = '\0';
-    period_str++;
-  }
-  char *digits_str = NULL;
-  char *algorithm_str = NULL;
-  if (period_str) {
-    digits_str = strchr(period_str, '|');
-    if (digits_str) {
-      *digits_str = '\0';
-      digits_str++;
-      
-      algorithm_str = strchr(digits_str, '|');
-      if (algorithm_str) {
-        *algorithm_str = '\0';
-        algorithm_str++;
-      }
-    }
-  }
-
-  // Trim spaces for label
-  char *trim_ptr = label;
-  while (*trim_ptr == ' ' || *trim_ptr == '\t') trim_ptr++;
-  memmove(label, trim_ptr, strlen(trim_ptr) + 1);
-  trim_ptr = label + strlen(label) - 1;
-  while (trim_ptr >= label && (*trim_ptr == ' ' || *trim_ptr == '\t')) {
-    *trim_ptr = '\0';
-    trim_ptr--;
-  }
-
-  // Trim spaces for account_name
-  trim_ptr = account_name;
-  while (*trim_ptr == ' ' || *trim_ptr == '\t') trim_ptr++;
-  memmove(account_name, trim_ptr, strlen(trim_ptr) + 1);
-  trim_ptr = account_name + strlen(account_name) - 1;
-  while (trim_ptr >= account_name && (*trim_ptr == ' ' || *trim_ptr == '\t')) {
-    *trim_ptr = '\0';
-    trim_ptr--;
-  }
-
-  // Trim spaces for secret
-  trim_ptr = secret;
-  while (*trim_ptr == ' ' || *trim_ptr == '\t') trim_ptr++;
-  memmove(secret, trim_ptr, strlen(trim_ptr) + 1);
-  trim_ptr = secret + strlen(secret) - 1;
-  while (trim_ptr >= secret && (*trim_ptr == ' ' || *trim_ptr == '\t')) {
-    *trim_ptr = '\0';
-    trim_ptr--;
-  }
-
-  if (period_str) {
-    trim_ptr = period_str;
-    while (*trim_ptr == ' ' || *trim_ptr == '\t') trim_ptr++;
-    memmove(period_str, trim_ptr, strlen(trim_ptr) + 1);
-    trim_ptr = period_str + strlen(period_str) - 1;
-    while (trim_ptr >= period_str && (*trim_ptr == ' ' || *trim_ptr == '\t')) {
-      *trim_ptr = '\0';
-      trim_ptr--;
-    }
-  }
-
-  if (digits_str) {
-    trim_ptr = digits_str;
-    while (*trim_ptr == ' ' || *trim_ptr == '\t') trim_ptr++;
-    memmove(digits_str, trim_ptr, strlen(trim_ptr) + 1);
-    trim_ptr = digits_str + strlen(digits_str) - 1;
-    while (trim_ptr >= digits_str && (*trim_ptr == ' ' || *trim_ptr == '\t')) {
-      *trim_ptr = '\0';
-      trim_ptr--;
-    }
-  }
-
-  if (algorithm_str) {
-    trim_ptr = algorithm_str;
-    while (*trim_ptr == ' ' || *trim_ptr == '\t') trim_ptr++;
-    memmove(algorithm_str, trim_ptr, strlen(trim_ptr) + 1);
-    trim_ptr = algorithm_str + strlen(algorithm_str) - 1;
-    while (trim_ptr >= algorithm_str && (*trim_ptr == ' ' || *trim_ptr == '\t')) {
-      *trim_ptr = '\0';
-      trim_ptr--;
-    }
-  }
+  char *period_str = prv_next_field(secret);
+  char *digits_str = prv_next_field(period_str);
+  char *algorithm_str = prv_next_field(digits_str);
+  char *type_str = prv_next_field(algorithm_str);
+  char *counter_str = prv_next_field(type_str);
+  prv_next_field(counter_str);
+
+  prv_trim(label);
+  prv_trim(account_name);
+  prv_trim(secret);
+  prv_trim(period_str);
+  prv_trim(digits_str);
+  prv_trim(algorithm_str);
+  prv_trim(type_str);
+  prv_trim(counter_str);
 
   if (label[0] == '\0' || secret[0] == '\0') {
     return false;
@@ -171,58 +141,201 @@ static bool prv_parse_line(const char *line, TotpAccount *out_account) {
   if (account.algorithm > TOTP_ALGO_SHA512) {
     account.algorithm = TOTP_ALGO_SHA1;
   }
+  account.type = type_str && type_str[0] ? (uint8_t)atoi(type_str) : OTP_TYPE_TOTP;
+  if (account.type > OTP_TYPE_HOTP) {
+    return false;
+  }
+  account.counter = counter_str && counter_str[0] ? prv_parse_u64(counter_str) : 0;
 
   *out_account = account;
   return true;
 }
 
-bool comms_parse_count(size_t count) {
+// ============================================================================
+// Trace dump
+// ============================================================================
+//
+// Events go out in chunks that fit the outbox, each one after the previous
+// is acknowledged. A message with the event count marks the end.
+
+#ifdef TRACE
+
+#define TRACE_CHUNK_EVENTS 12
+
+static bool s_trace_sending = false;
+static size_t s_trace_next = 0;  // First event not sent yet
+
+static void prv_finish_trace(void) {
+  s_trace_sending = false;
+  trace_freeze(false);
+}
+
+static void prv_send_trace_chunk(void) {
+  DictionaryIterator *iter = NULL;
+  if (app_message_outbox_begin(&iter) != APP_MSG_OK || !iter) {
+    APP_LOG(APP_LOG_LEVEL_WARNING, "Trace dump stopped at event %d", (int)s_trace_next);
+    prv_finish_trace();
+    return;
+  }
+
+  TraceRecord records[TRACE_CHUNK_EVENTS];
+  size_t count = trace_read(s_trace_next, records, TRACE_CHUNK_EVENTS);
+  if (count > 0) {
+    dict_write_data(iter, MESSAGE_KEY_AppKeyTrace, (const uint8_t *)records, count * sizeof(TraceRecord));
+    s_trace_next += count;
+  } else {
+    dict_write_uint32(iter, MESSAGE_KEY_AppKeyTrace, trace_get_count());
+    prv_finish_trace();
+  }
+  app_message_outbox_send();
+}
+
+#endif
+
+bool comms_send_trace(void) {
+#ifdef TRACE
+  if (s_sync_active) {
+    // The sync needs the outbox for its status
+    APP_LOG(APP_LOG_LEVEL_WARNING, "No trace dump during a sync");
+    return false;
+  }
+  if (!s_trace_sending) {
+    // The buffer holds still until the last chunk is out
+    trace_freeze(true);
+    s_trace_sending = true;
+    s_trace_next = 0;
+    prv_send_trace_chunk();
+  }
+  return true;
+#else
+  return false;
+#endif
+}
+
+// Drop the staged list and tell the phone and the UI, the current list stays
+static void prv_fail_sync(uint8_t status_code) {
+  s_sync_active = false;
+  storage_sync_abort();
+  prv_send_status(status_code);
+  ui_set_loading(false);
+  if (status_code == SYNC_STATUS_NO_SPACE) {
+    ui_set_storage_full(true);
+  }
+  memory_phase_end(MEMORY_PHASE_SYNC);
+}
+
+static void prv_commit_sync(void) {
+  s_sync_active = false;
+  if (!storage_sync_commit()) {
+    // The bank index couldn't be written
+    APP_LOG(APP_LOG_LEVEL_ERROR, "Failed to commit synced accounts");
+    prv_fail_sync(SYNC_STATUS_NO_SPACE);
+    return;
+  }
+  storage_collect_garbage();
+
+  // Ended before the list reloads, the reload refills the account pool
+  // the reserve is measured on top of
+  memory_phase_end(MEMORY_PHASE_SYNC);
+  ui_set_synced_count(s_sync_expected_count);
+  prv_send_status(SYNC_STATUS_OK);
+  diagnostics_sync_finished();
+}
+
+bool comms_parse_count(size_t count, size_t payload_size) {
+#ifdef TRACE
+  if (s_trace_sending) {
+    // Free the outbox for the sync status
+    APP_LOG(APP_LOG_LEVEL_WARNING, "Trace dump stopped for a sync");
+    prv_finish_trace();
+  }
+#endif
+  s_sync_active = false;
   s_sync_expected_count = count;
   s_sync_received_count = 0;
+  memory_phase_begin(MEMORY_PHASE_SYNC);
+
+  // Reject lists that can't fit before anything is written,
+  // the phone stops sending when it gets the status
+  if (count > STORAGE_MAX_ACCOUNTS ||
+      (payload_size > 0 && !storage_list_fits(count, payload_size))) {
+    APP_LOG(APP_LOG_LEVEL_WARNING, "%d accounts (%d bytes) don't fit", (int)count, (int)payload_size);
+    prv_fail_sync(SYNC_STATUS_NO_SPACE);
+    return false;
+  }
+  ui_set_storage_full(false);
 
-  storage_set_count(0);
-  ui_set_total_count(0);
+  // New accounts go to the inactive bank, the list keeps showing
+  // the current ones until every entry has arrived
+  if (!storage_sync_begin(count)) {
+    APP_LOG(APP_LOG_LEVEL_ERROR, "Failed to start sync of %d accounts", (int)count);
+    memory_phase_end(MEMORY_PHASE_SYNC);
+    return false;
+  }
+  s_sync_active = true;
   ui_set_loading(true);
+  diagnostics_sync_started();
+
+  // An empty list has no entries to wait for
+  if (count == 0) {
+    prv_commit_sync();
+  }
 
   return true;
 }
 
 bool comms_parse_account(size_t id, const char *data) {
-  if (!data) return false;
+  if (!data || !s_sync_active) return false;
 
   TotpAccount account;
-  if (!prv_parse_line(data, &account)) {
+  diagnostics_sync_received(strlen(data));
+  PROFILE_START(start);
+  bool parsed = prv_parse_line(data, &account);
+  PROFILE_STOP(PROFILE_PARSE_ACCOUNT, start);
+  if (!parsed) {
+    APP_LOG(APP_LOG_LEVEL_WARNING, "Account %d can't be parsed", (int)id);
+    prv_fail_sync(SYNC_STATUS_INVALID);
     return false;
   }
 
-  if (!storage_save_account(id, &account)) {
+  // Out of space or a failed write, the rest of the list can't be stored
+  if (!storage_sync_save_account(id, &account)) {
+    prv_fail_sync(SYNC_STATUS_NO_SPACE);
     return false;
   }
 
   s_sync_received_count++;
 
   if (s_sync_received_count >= s_sync_expected_count) {
-    storage_set_count(s_sync_expected_count);
-    ui_set_total_count(s_sync_expected_count);
-    prv_send_status(1);
+    prv_commit_sync();
   }
 
   return true;
 }
 
+// ============================================================================
+// AppMessage handlers
+// ============================================================================
 
-static void prv_inbox_received(DictionaryIterator *iter, void *context) {
-  (void)context;
-  
+static void prv_handle_message(DictionaryIterator *iter) {
   Tuple *count_tuple = dict_find(iter, MESSAGE_KEY_AppKeyCount);
   if (count_tuple) {
+    // Sent by newer phone code only, 0 skips the up front size check
+    size_t payload_size = 0;
+    Tuple *size_tuple = dict_find(iter, MESSAGE_KEY_AppKeySize);
+    if (size_tuple && size_tuple->type == TUPLE_INT) {
+      payload_size = (size_t)size_tuple->value->int32;
+    } else if (size_tuple && size_tuple->type == TUPLE_UINT) {
+      payload_size = (size_t)size_tuple->value->uint32;
+    }
+
     if (count_tuple->type == TUPLE_INT) {
       size_t count = (size_t)count_tuple->value->int32;
-      comms_parse_count(count);
+      comms_parse_count(count, payload_size);
       return;
     } else if (count_tuple->type == TUPLE_UINT) {
       size_t count = (size_t)count_tuple->value->uint16;
-      comms_parse_count(count);
+      comms_parse_count(count, payload_size);
       return;
     }
   }
@@ -239,6 +352,14 @@ static void prv_inbox_received(DictionaryIterator *iter, void *context) {
   }
 }
 
+static void prv_inbox_received(DictionaryIterator *iter, void *context) {
+  (void)context;
+  
+  TRACE_BEGIN(TRACE_MESSAGE_IN, 0);
+  prv_handle_message(iter);
+  TRACE_END(TRACE_MESSAGE_IN, 0);
+}
+
 static void prv_inbox_dropped(AppMessageResult reason, void *context) {
   (void)reason;
   (void)context;
@@ -248,11 +369,22 @@ static void prv_outbox_failed(DictionaryIterator *iter, AppMessageResult reason,
   (void)iter;
   (void)reason;
   (void)context;
+#ifdef TRACE
+  if (s_trace_sending) {
+    APP_LOG(APP_LOG_LEVEL_WARNING, "Trace dump failed: %d", reason);
+    prv_finish_trace();
+  }
+#endif
 }
 
 static void prv_outbox_sent(DictionaryIterator *iter, void *context) {
   (void)iter;
   (void)context;
+#ifdef TRACE
+  if (s_trace_sending) {
+    prv_send_trace_chunk();
+  }
+#endif
 }
 
 void comms_init(void) {
@@ -270,6 +402,9 @@ void comms_init(void) {
 
 void comms_deinit(void) {
   app_message_deregister_callbacks();
+  s_sync_active = false;
+  storage_sync_abort();
+  memory_phase_end(MEMORY_PHASE_SYNC);
 }
 
 void comms_request_sync(void) {
@@ -12,10 +12,12 @@ void comms_deinit(void);
 // Send sync request
 void comms_request_sync(void);
 
-// Data sending functions from watch to phone are not used (unidirectional sync)
+// Send the event trace to the phone, false if this isn't a TRACE build
+// or a sync is in progress
+bool comms_send_trace(void);
 
-// Parse account count
-bool comms_parse_count(size_t count);
+// Parse account count and total size of labels, account names and secrets
+bool comms_parse_count(size_t count, size_t payload_size);
 
 // Parse individual account
 bool comms_parse_account(size_t id, const char *data);
@@ -2,7 +2,30 @@
 
 #define VERSION "1.2"
 
-#define MEMORY_CRITICAL_LEVEL 4000
+// Heap left free for syncing and settings until measured, see memory.h
+#define HEAP_RESERVE_DEFAULT 4000
+// Added to a measured reserve for what sampling can miss
+#define HEAP_RESERVE_MARGIN 512
+// A launch that measured less moves the stored reserve this fraction of
+// the way down, so one large sync doesn't hold memory back for good
+#define HEAP_RESERVE_DECAY 4
+
+// Accounts kept loaded: visible rows plus a prefetch margin
+#define ACCOUNT_POOL_SIZE 8
+#define ACCOUNT_PREFETCH_ROWS 2
+
+// Idle policy defaults, in seconds without button presses
+#define DEFAULT_IDLE_SECONDS 60  // Until falling back to low power refreshing
+#define DEFAULT_EXIT_SECONDS 600  // Until the app exits
+
+// Persistent storage budget of an app, in bytes of stored values
+#define PERSIST_QUOTA 4096
 
 //#define DEBUG
 #define DEBUG_ACCOUNTS 25
+
+// Time hot paths and log the counters, see profile.h
+//#define PROFILE
+
+// Record events for the phone to turn into a timeline, see trace.h
+//#define TRACE
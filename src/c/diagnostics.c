@@ -0,0 +1,62 @@
+#include "diagnostics.h"
+#include "memory.h"
+#include "profile.h"
+
+// Probing stops once the remaining range is this small
+#define PROBE_RESOLUTION 16
+
+static Diagnostics s_diagnostics;
+static uint32_t s_sync_started = 0;
+static size_t s_sync_bytes = 0;
+
+size_t diagnostics_probe_largest_free_block(void) {
+  // Binary search between what surely fits and the total free bytes
+  size_t low = 0;
+  size_t high = heap_bytes_free();
+  while (high - low > PROBE_RESOLUTION) {
+    size_t mid = low + (high - low) / 2;
+    void *block = malloc(mid);
+    if (block) {
+      free(block);
+      low = mid;
+    } else {
+      high = mid;
+    }
+  }
+  return low;
+}
+
+void diagnostics_count_code(void) {
+  s_diagnostics.codes_computed++;
+}
+
+void diagnostics_record_refresh(uint32_t start) {
+  s_diagnostics.refresh_total_ms += profile_now() - start;
+  s_diagnostics.refresh_count++;
+  memory_sample();
+}
+
+void diagnostics_sync_started(void) {
+  s_sync_started = profile_now();
+  s_sync_bytes = 0;
+  memory_sample();
+}
+
+void diagnostics_sync_received(size_t bytes) {
+  s_sync_bytes += bytes;
+  memory_sample();
+}
+
+void diagnostics_sync_finished(void) {
+  if (s_sync_started == 0) return;
+
+  uint32_t duration = profile_now() - s_sync_started;
+  s_diagnostics.sync_duration_ms = duration > 0 ? duration : 1;
+  s_diagnostics.sync_bytes = s_sync_bytes;
+  s_sync_started = 0;
+  memory_sample();
+}
+
+const Diagnostics *diagnostics_get(void) {
+  return &s_diagnostics;
+}
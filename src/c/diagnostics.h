@@ -0,0 +1,28 @@
+#pragma once
+
+#include <pebble.h>
+
+// Always-on counters shown by the System Info window. Each update is a
+// few additions, so they stay in release builds.
+typedef struct {
+  uint32_t codes_computed;    // HMACs since launch
+  uint32_t refresh_count;     // ui_update_codes runs
+  uint32_t refresh_total_ms;
+  uint32_t sync_duration_ms;  // Last completed sync, 0 if none yet
+  size_t sync_bytes;          // Account data received by the last sync
+} Diagnostics;
+
+// Largest block malloc can currently return, found by trying
+size_t diagnostics_probe_largest_free_block(void);
+
+void diagnostics_count_code(void);
+
+// A refresh that started at the given profile_now() finished
+void diagnostics_record_refresh(uint32_t start);
+
+// Sync progress, the duration runs from start to finish
+void diagnostics_sync_started(void);
+void diagnostics_sync_received(size_t bytes);
+void diagnostics_sync_finished(void);
+
+const Diagnostics *diagnostics_get(void);
@@ -0,0 +1,137 @@
+#include "memory.h"
+#include "storage.h"
+#include "config.h"
+#include <string.h>
+
+// Size of each block, in front of it and padded to keep blocks aligned
+typedef union {
+  size_t size;
+  uint64_t align;
+} BlockHeader;
+
+static size_t s_tracked = 0;
+static size_t s_peak = 0;
+static MemoryPhaseStats s_phases[MEMORY_PHASE_COUNT];
+static uint8_t s_active_phases = 0;  // Bit per MemoryPhase
+static size_t s_stored_reserve = 0;
+static bool s_stored_reserve_loaded = false;
+
+void memory_sample(void) {
+  size_t used = heap_bytes_used();
+  if (used > s_peak) {
+    s_peak = used;
+  }
+  for (int i = 0; i < MEMORY_PHASE_COUNT; i++) {
+    if ((s_active_phases & (1 << i)) && used > s_phases[i].peak) {
+      s_phases[i].peak = used;
+    }
+  }
+}
+
+void *memory_malloc(size_t size) {
+  BlockHeader *header = malloc(sizeof(BlockHeader) + size);
+  if (!header) {
+    APP_LOG(APP_LOG_LEVEL_WARNING, "Allocation of %d B failed, %d B free", (int)size, (int)heap_bytes_free());
+    return NULL;
+  }
+  header->size = size;
+  s_tracked += size;
+  memory_sample();
+  return header + 1;
+}
+
+void *memory_calloc(size_t count, size_t size) {
+  if (size > 0 && count > SIZE_MAX / size) return NULL;
+
+  void *ptr = memory_malloc(count * size);
+  if (ptr) {
+    memset(ptr, 0, count * size);
+  }
+  return ptr;
+}
+
+void memory_free(void *ptr) {
+  if (!ptr) return;
+
+  // Sampled before, the peak is reached just before the free
+  memory_sample();
+  BlockHeader *header = (BlockHeader *)ptr - 1;
+  s_tracked -= header->size;
+  free(header);
+}
+
+void memory_phase_begin(MemoryPhase phase) {
+  size_t used = heap_bytes_used();
+  s_phases[phase].start = used;
+  if (used > s_phases[phase].peak) {
+    s_phases[phase].peak = used;
+  }
+  s_active_phases |= 1 << phase;
+}
+
+void memory_phase_end(MemoryPhase phase) {
+  memory_sample();
+  s_active_phases &= ~(1 << phase);
+}
+
+size_t memory_get_tracked(void) {
+  return s_tracked;
+}
+
+size_t memory_get_peak(void) {
+  return s_peak;
+}
+
+const MemoryPhaseStats *memory_get_phase(MemoryPhase phase) {
+  return &s_phases[phase];
+}
+
+// Most heap a phase that starts on top of the list took this launch
+static size_t prv_measured_reserve(void) {
+  static const MemoryPhase phases[] = { MEMORY_PHASE_SYNC, MEMORY_PHASE_SETTINGS };
+  size_t reserve = 0;
+  for (size_t i = 0; i < ARRAY_LENGTH(phases); i++) {
+    const MemoryPhaseStats *stats = &s_phases[phases[i]];
+    if (stats->peak > stats->start && stats->peak - stats->start > reserve) {
+      reserve = stats->peak - stats->start;
+    }
+  }
+  return reserve;
+}
+
+size_t memory_get_reserve(void) {
+  if (!s_stored_reserve_loaded) {
+    s_stored_reserve = storage_get_heap_reserve();
+    s_stored_reserve_loaded = true;
+  }
+
+  size_t reserve = prv_measured_reserve();
+  if (s_stored_reserve > reserve) {
+    reserve = s_stored_reserve;
+  }
+  if (reserve == 0) {
+    // Nothing measured on this watch yet
+    return HEAP_RESERVE_DEFAULT;
+  }
+  return reserve + HEAP_RESERVE_MARGIN;
+}
+
+void memory_save(void) {
+  APP_LOG(APP_LOG_LEVEL_DEBUG, "Heap peaks: %d overall, startup %d, sync %d, settings %d",
+          (int)s_peak, (int)s_phases[MEMORY_PHASE_STARTUP].peak,
+          (int)s_phases[MEMORY_PHASE_SYNC].peak, (int)s_phases[MEMORY_PHASE_SETTINGS].peak);
+
+  size_t measured = prv_measured_reserve();
+  if (measured == 0) return;  // No sync or settings this launch
+  if (measured > UINT16_MAX) measured = UINT16_MAX;
+
+  // Grow at once, shrink gradually
+  size_t stored = storage_get_heap_reserve();
+  size_t reserve = measured;
+  if (measured < stored) {
+    reserve = stored - (stored - measured + HEAP_RESERVE_DECAY - 1) / HEAP_RESERVE_DECAY;
+  }
+  if (reserve != stored) {
+    storage_set_heap_reserve(reserve);
+  }
+}
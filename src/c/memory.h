@@ -0,0 +1,48 @@
+#pragma once
+
+#include <pebble.h>
+
+// Heap tracking for the app's own allocations. Every allocation and free
+// also samples the whole heap, so each phase of the app's life gets the
+// highest heap use seen while it ran. What the sync and settings phases
+// needed on top of the heap in use when they started is kept across
+// launches as the reserve the account loader leaves free.
+
+typedef enum {
+  MEMORY_PHASE_STARTUP,   // Launch until the list or pinned account is up
+  MEMORY_PHASE_SYNC,      // Receiving an account list
+  MEMORY_PHASE_SETTINGS,  // Settings and the windows opened from it
+  MEMORY_PHASE_COUNT
+} MemoryPhase;
+
+typedef struct {
+  size_t start;  // heap_bytes_used() when the phase last began
+  size_t peak;   // Highest heap_bytes_used() while it ran, 0 if it never did
+} MemoryPhaseStats;
+
+// malloc, calloc and free that keep count of the bytes held
+void *memory_malloc(size_t size);
+void *memory_calloc(size_t count, size_t size);
+void memory_free(void *ptr);
+
+// Phases may overlap, a settings window can be open during a sync
+void memory_phase_begin(MemoryPhase phase);
+void memory_phase_end(MemoryPhase phase);
+
+// Note the current heap use, allocations do this on their own
+void memory_sample(void);
+
+// Bytes held by memory_malloc and memory_calloc blocks
+size_t memory_get_tracked(void);
+
+// Highest heap_bytes_used() since launch
+size_t memory_get_peak(void);
+
+const MemoryPhaseStats *memory_get_phase(MemoryPhase phase);
+
+// Heap to leave free for the phases that can start while the list is up
+size_t memory_get_reserve(void);
+
+// Store the reserve for the next launch. More than stored replaces it,
+// less moves it 1/HEAP_RESERVE_DECAY of the way down.
+void memory_save(void);
@@ -6,3 +6,5 @@
 #define MESSAGE_KEY_AppKeyCount 3
 #define MESSAGE_KEY_AppKeyEntry 4
 #define MESSAGE_KEY_AppKeyEntryId 5
+#define MESSAGE_KEY_AppKeySize 6
+#define MESSAGE_KEY_AppKeyTrace 7
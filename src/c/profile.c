@@ -0,0 +1,77 @@
+#include "profile.h"
+#include <string.h>
+
+uint32_t profile_now(void) {
+  time_t seconds;
+  uint16_t ms;
+  time_ms(&seconds, &ms);
+  return (uint32_t)seconds * 1000 + ms;
+}
+
+#ifdef PROFILE
+
+typedef struct {
+  uint32_t count;
+  uint32_t total_ms;
+  uint16_t min_ms;
+  uint16_t max_ms;
+} ProfileStats;
+
+static const char *const s_counter_names[PROFILE_COUNTER_COUNT] = {
+  [PROFILE_UPDATE_CODES] = "update_codes",
+  [PROFILE_DRAW_ROW] = "draw_row",
+  [PROFILE_TOTP_SHA1] = "totp_sha1",
+  [PROFILE_TOTP_SHA256] = "totp_sha256",
+  [PROFILE_TOTP_SHA512] = "totp_sha512",
+  [PROFILE_LOAD_ACCOUNT] = "load_account",
+  [PROFILE_PARSE_ACCOUNT] = "parse_account",
+};
+
+static ProfileStats s_stats[PROFILE_COUNTER_COUNT];
+static AppTimer *s_dump_timer = NULL;
+
+static void prv_dump_timer_callback(void *data) {
+  profile_dump();
+  s_dump_timer = app_timer_register(PROFILE_DUMP_INTERVAL_MS, prv_dump_timer_callback, NULL);
+}
+
+void profile_init(void) {
+  memset(s_stats, 0, sizeof(s_stats));
+  s_dump_timer = app_timer_register(PROFILE_DUMP_INTERVAL_MS, prv_dump_timer_callback, NULL);
+}
+
+void profile_deinit(void) {
+  if (s_dump_timer) {
+    app_timer_cancel(s_dump_timer);
+    s_dump_timer = NULL;
+  }
+  profile_dump();
+}
+
+void profile_record(ProfileCounter counter, uint32_t start) {
+  if (counter >= PROFILE_COUNTER_COUNT) return;
+
+  uint32_t elapsed = profile_now() - start;
+  uint16_t ms = elapsed > UINT16_MAX ? UINT16_MAX : elapsed;
+  ProfileStats *stats = &s_stats[counter];
+  if (stats->count == 0 || ms < stats->min_ms) stats->min_ms = ms;
+  if (ms > stats->max_ms) stats->max_ms = ms;
+  stats->total_ms += ms;
+  stats->count++;
+}
+
+void profile_dump(void) {
+  for (int i = 0; i < PROFILE_COUNTER_COUNT; i++) {
+    ProfileStats *stats = &s_stats[i];
+    if (stats->count == 0) continue;
+
+    // Most paths take about a millisecond, the average gets a tenth
+    uint32_t avg_tenths = stats->total_ms * 10 / stats->count;
+    APP_LOG(APP_LOG_LEVEL_INFO, "PROFILE %s: n=%lu avg=%lu.%lu min=%u max=%u ms",
+            s_counter_names[i], (unsigned long)stats->count,
+            (unsigned long)(avg_tenths / 10), (unsigned long)(avg_tenths % 10),
+            stats->min_ms, stats->max_ms);
+  }
+}
+
+#endif
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <pebble.h>
+#include "config.h"
+
+// Timing counters for hot paths, only compiled in with PROFILE defined in
+// config.h. Release builds get empty macros and no profiling code.
+//
+//   PROFILE_START(start);
+//   ...
+//   PROFILE_STOP(PROFILE_LOAD_ACCOUNT, start);
+
+typedef enum {
+  PROFILE_UPDATE_CODES,
+  PROFILE_DRAW_ROW,
+  PROFILE_TOTP_SHA1,  // Per TotpAlgorithm, in the same order
+  PROFILE_TOTP_SHA256,
+  PROFILE_TOTP_SHA512,
+  PROFILE_LOAD_ACCOUNT,
+  PROFILE_PARSE_ACCOUNT,
+  PROFILE_COUNTER_COUNT
+} ProfileCounter;
+
+// Milliseconds since the epoch, truncated. Always built, the diagnostics
+// page times refreshes and syncs with it too.
+uint32_t profile_now(void);
+
+#ifdef PROFILE
+
+// Counters are logged this often and when the app exits
+#define PROFILE_DUMP_INTERVAL_MS 30000
+
+void profile_init(void);
+void profile_deinit(void);
+
+// Count one run of a hot path that started at the given profile_now()
+void profile_record(ProfileCounter counter, uint32_t start);
+
+// Log all counters that ran at least once
+void profile_dump(void);
+
+#define PROFILE_START(start) uint32_t start = profile_now()
+#define PROFILE_STOP(counter, start) profile_record(counter, start)
+
+#else
+
+#define profile_init()
+#define profile_deinit()
+#define profile_dump()
+#define PROFILE_START(start)
+#define PROFILE_STOP(counter, start)
+
+#endif
@@ -1,4 +1,5 @@
 #include "selection_layer.h"
+#include "activity.h"
 
 typedef struct {
   int index;
@@ -68,6 +69,7 @@ static void prv_layer_update_proc(Layer *layer, GContext *ctx) {
 
 static void prv_select_click_handler(ClickRecognizerRef recognizer, void *context) {
   SelectionLayer *selection_layer = (SelectionLayer*)context;
+  activity_note();
   
   selection_layer->active_cell++;
   if (selection_layer->active_cell >= selection_layer->num_cells) {
@@ -83,6 +85,7 @@ static void prv_select_click_handler(ClickRecognizerRef recognizer, void *contex
 
 static void prv_up_click_handler(ClickRecognizerRef recognizer, void *context) {
   SelectionLayer *selection_layer = (SelectionLayer*)context;
+  activity_note();
   
   if (selection_layer->callbacks.increment) {
     selection_layer->callbacks.increment(selection_layer->active_cell, 1, selection_layer->callback_context);
@@ -93,6 +96,7 @@ static void prv_up_click_handler(ClickRecognizerRef recognizer, void *context) {
 
 static void prv_down_click_handler(ClickRecognizerRef recognizer, void *context) {
   SelectionLayer *selection_layer = (SelectionLayer*)context;
+  activity_note();
   
   if (selection_layer->callbacks.decrement) {
     selection_layer->callbacks.decrement(selection_layer->active_cell, 1, selection_layer->callback_context);
@@ -3,11 +3,25 @@
 #include "storage.h"
 #include "ui.h"
 #include "config.h"
+#include "diagnostics.h"
+#include "memory.h"
+#include "comms.h"
+#include "activity.h"
+#include "profile.h"
 
 #define MENU_SECTION_MAIN 0
 #define MENU_ROW_PIN_ACTION 0
 #define MENU_ROW_STATUSBAR_TOGGLE 1
-#define MENU_ROW_SYSTEM_INFO 2
+#define MENU_ROW_REFRESH_TOGGLE 2
+#define MENU_ROW_ORDER_TOGGLE 3
+#define MENU_ROW_PINNED_TOGGLE 4
+#define MENU_ROW_IDLE_TIMEOUT 5
+#define MENU_ROW_EXIT_TIMEOUT 6
+#define MENU_ROW_SYSTEM_INFO 7
+
+// Timeouts cycled through by the idle rows, 0 is never
+static const uint16_t s_idle_options[] = { 0, 30, 60, 120, 300 };
+static const uint16_t s_exit_options[] = { 0, 120, 300, 600, 1800 };
 
 typedef enum {
   PIN_MODE_NONE,
@@ -21,7 +35,12 @@ struct SettingsWindow {
   MenuLayer *menu_layer;
   PinWindow *pin_window;
   Window *info_window;
+  ScrollLayer *info_scroll_layer;  // The page is taller than small screens
   TextLayer *info_text_layer;
+  AppTimer *info_timer;
+  size_t info_persist_used;  // Read once per opening, it walks every persist key
+  size_t info_largest_block;  // Probed every INFO_PROBE_INTERVAL_MS, it takes many mallocs
+  uint32_t info_probed_at;  // profile_now() of the last probe, 0 before the first
   PinMode current_mode;
   Pin first_pin;  // Store first PIN entry for confirmation
 };
@@ -32,6 +51,28 @@ static SettingsWindow *s_settings_window = NULL;
 static void prv_info_window_load(Window *window);
 static void prv_info_window_unload(Window *window);
 
+// ============================================================================
+// Timeout options
+// ============================================================================
+
+static void prv_format_timeout(uint16_t seconds, char *buffer, size_t size) {
+  if (seconds == 0) {
+    snprintf(buffer, size, "Never");
+  } else if (seconds < 60) {
+    snprintf(buffer, size, "After %d s", seconds);
+  } else {
+    snprintf(buffer, size, "After %d min", seconds / 60);
+  }
+}
+
+// Option after the current one, the first one if it isn't in the list
+static uint16_t prv_next_timeout(const uint16_t *options, size_t count, uint16_t current) {
+  for (size_t i = 0; i + 1 < count; i++) {
+    if (options[i] == current) return options[i + 1];
+  }
+  return options[0];
+}
+
 // ============================================================================
 // PIN window callbacks
 // ============================================================================
@@ -119,7 +160,7 @@ static uint16_t prv_menu_get_num_sections_callback(MenuLayer *menu_layer, void *
 }
 
 static uint16_t prv_menu_get_num_rows_callback(MenuLayer *menu_layer, uint16_t section_index, void *data) {
-  return 3;  // PIN action, Status Bar toggle, System Info
+  return 8;  // PIN action, Status Bar, Refresh, Order, Pinned, Idle and Exit toggles, System Info
 }
 
 static int16_t prv_menu_get_header_height_callback(MenuLayer *menu_layer, uint16_t section_index, void *data) {
@@ -148,16 +189,58 @@ static void prv_menu_draw_row_callback(GContext* ctx, const Layer *cell_layer, M
                           statusbar_enabled ? "Enabled" : "Disabled", NULL);
       break;
       
+    case MENU_ROW_REFRESH_TOGGLE:
+      menu_cell_basic_draw(ctx, cell_layer, "Refresh",
+                          storage_is_low_power_refresh_enabled() ? "Low power" : "Every second", NULL);
+      break;
+      
+    case MENU_ROW_ORDER_TOGGLE:
+      menu_cell_basic_draw(ctx, cell_layer, "Order",
+                          storage_is_most_used_first_enabled() ? "Most used first" : "As on phone", NULL);
+      break;
+      
+    case MENU_ROW_PINNED_TOGGLE:
+      {
+        // Settings are opened from a row, it's the one that gets pinned
+        const char *status = "Off";
+        size_t id;
+        OtpType type;
+        if (ui_get_selected_row(&id, &type) && type == OTP_TYPE_TOTP && storage_is_pinned_account_id(id)) {
+          status = "This account";
+        } else if (storage_has_pinned_account()) {
+          status = "Other account";
+        }
+        menu_cell_basic_draw(ctx, cell_layer, "Open on Launch", status, NULL);
+      }
+      break;
+      
+    case MENU_ROW_IDLE_TIMEOUT:
+    case MENU_ROW_EXIT_TIMEOUT:
+      {
+        bool idle = cell_index->row == MENU_ROW_IDLE_TIMEOUT;
+        char status[16];
+        prv_format_timeout(idle ? storage_get_idle_seconds() : storage_get_exit_seconds(), status, sizeof(status));
+        menu_cell_basic_draw(ctx, cell_layer, idle ? "Idle Low Power" : "Auto Exit", status, NULL);
+      }
+      break;
+      
     case MENU_ROW_SYSTEM_INFO:
-      menu_cell_basic_draw(ctx, cell_layer, "System Info", "Version & Memory", NULL);
+      menu_cell_basic_draw(ctx, cell_layer, "System Info", "Diagnostics", NULL);
       break;
   }
 }
 
+static void prv_menu_selection_changed_callback(MenuLayer *menu_layer, MenuIndex new_index,
+                                                MenuIndex old_index, void *data) {
+  activity_note();
+}
+
 static void prv_menu_select_callback(MenuLayer *menu_layer, MenuIndex *cell_index, void *data) {
   SettingsWindow *settings = (SettingsWindow*)data;
   bool has_pin = storage_has_pin();
   
+  activity_note();
+  
   switch (cell_index->row) {
     case MENU_ROW_PIN_ACTION:
       // Create PIN window if it doesn't exist
@@ -202,6 +285,84 @@ static void prv_menu_select_callback(MenuLayer *menu_layer, MenuIndex *cell_inde
       }
       break;
       
+    case MENU_ROW_REFRESH_TOGGLE:
+      // Toggle refresh mode setting
+      {
+        bool low_power = !storage_is_low_power_refresh_enabled();
+        storage_set_low_power_refresh_enabled(low_power);
+        
+        // Reload menu to show new status
+        menu_layer_reload_data(menu_layer);
+        
+        ui_set_low_power_refresh(low_power);
+        
+        vibes_short_pulse();
+      }
+      break;
+      
+    case MENU_ROW_ORDER_TOGGLE:
+      // Toggle list order setting
+      {
+        bool most_used_first = !storage_is_most_used_first_enabled();
+        storage_set_most_used_first_enabled(most_used_first);
+        
+        // Reload menu to show new status
+        menu_layer_reload_data(menu_layer);
+        
+        // Reorder the list behind the settings window
+        ui_reorder_accounts();
+        
+        vibes_short_pulse();
+      }
+      break;
+      
+    case MENU_ROW_PINNED_TOGGLE:
+      // Pin the selected account, or unpin it if it already is
+      {
+        size_t id;
+        TotpAccount *account = ui_get_selected_account(&id);
+        if (!account || account->type != OTP_TYPE_TOTP) {
+          // HOTP codes are only generated on request
+          vibes_double_pulse();
+          break;
+        }
+        
+        if (storage_is_pinned_account(account)) {
+          storage_clear_pinned_account();
+        } else {
+          storage_set_pinned_account(id, account);
+        }
+        
+        // Reload menu to show new status
+        menu_layer_reload_data(menu_layer);
+        
+        vibes_short_pulse();
+      }
+      break;
+      
+    case MENU_ROW_IDLE_TIMEOUT:
+    case MENU_ROW_EXIT_TIMEOUT:
+      // Cycle through the timeout options
+      {
+        uint16_t idle_seconds = storage_get_idle_seconds();
+        uint16_t exit_seconds = storage_get_exit_seconds();
+        if (cell_index->row == MENU_ROW_IDLE_TIMEOUT) {
+          idle_seconds = prv_next_timeout(s_idle_options, ARRAY_LENGTH(s_idle_options), idle_seconds);
+          storage_set_idle_seconds(idle_seconds);
+        } else {
+          exit_seconds = prv_next_timeout(s_exit_options, ARRAY_LENGTH(s_exit_options), exit_seconds);
+          storage_set_exit_seconds(exit_seconds);
+        }
+        
+        // Reload menu to show new status
+        menu_layer_reload_data(menu_layer);
+        
+        activity_set_timeouts(idle_seconds, exit_seconds);
+        
+        vibes_short_pulse();
+      }
+      break;
+      
     case MENU_ROW_SYSTEM_INFO:
       // Create and show system info window
       if (!settings->info_window) {
@@ -225,51 +386,138 @@ static void prv_menu_select_callback(MenuLayer *menu_layer, MenuIndex *cell_inde
 // ============================================================================
 // System Information window
 // ============================================================================
+//
+// A live diagnostics page, refreshed every INFO_REFRESH_MS while open.
+// UP and DOWN scroll it, it doesn't fit on 168 px screens.
+
+#define INFO_REFRESH_MS 1000
+#define INFO_PROBE_INTERVAL_MS 10000
+#define INFO_MARGIN 5
+#define INFO_TEXT_MAX_HEIGHT 2000  // Lays out the whole text, the scroll layer clips it
+
+static void prv_update_info(void *data) {
+  SettingsWindow *settings = (SettingsWindow*)data;
+  settings->info_timer = NULL;
+  if (!settings->info_text_layer) return;
+  
+  const Diagnostics *diagnostics = diagnostics_get();
+  memory_sample();
+  
+  uint32_t now = profile_now();
+  if (settings->info_probed_at == 0 || now - settings->info_probed_at >= INFO_PROBE_INTERVAL_MS) {
+    settings->info_largest_block = diagnostics_probe_largest_free_block();
+    settings->info_probed_at = now;
+  }
+  
+  // Averages are shown with one decimal
+  uint32_t refresh_tenths = diagnostics->refresh_count > 0 ?
+    diagnostics->refresh_total_ms * 10 / diagnostics->refresh_count : 0;
+  uint32_t sync_rate = diagnostics->sync_duration_ms > 0 ?
+    diagnostics->sync_bytes * 1000 / diagnostics->sync_duration_ms : 0;
+  
+  static char info_buffer[320];
+  snprintf(info_buffer, sizeof(info_buffer),
+    "Version: %s\n"
+    "Accounts: %d loaded / %d\n"
+    "Heap: %d used, %d free\n"
+    "Heap peak: %d, reserve %d\n"
+    "Largest block: %d B\n"
+    "Persist: %d / %d B\n"
+    "Last sync: %d ms, %d B/s\n"
+    "Refresh: %d.%d ms avg\n"
+    "Codes: %d since launch",
+    VERSION,
+    (int)ui_get_resident_count(), (int)s_total_account_count,
+    (int)heap_bytes_used(), (int)heap_bytes_free(),
+    (int)memory_get_peak(), (int)memory_get_reserve(),
+    (int)settings->info_largest_block,
+    (int)settings->info_persist_used, PERSIST_QUOTA,
+    (int)diagnostics->sync_duration_ms, (int)sync_rate,
+    (int)(refresh_tenths / 10), (int)(refresh_tenths % 10),
+    (int)diagnostics->codes_computed
+  );
+  text_layer_set_text(settings->info_text_layer, info_buffer);
+  
+  // Lines can wrap differently as the numbers change
+  GRect bounds = layer_get_bounds(scroll_layer_get_layer(settings->info_scroll_layer));
+  GSize text_size = text_layer_get_content_size(settings->info_text_layer);
+  scroll_layer_set_content_size(settings->info_scroll_layer,
+                                GSize(bounds.size.w, text_size.h + 4 * INFO_MARGIN));
+  
+  settings->info_timer = app_timer_register(INFO_REFRESH_MS, prv_update_info, settings);
+}
+
+static void prv_info_select_handler(ClickRecognizerRef recognizer, void *context) {
+  activity_note();
+#ifdef TRACE
+  // SELECT sends the event trace to the phone
+  if (comms_send_trace()) {
+    vibes_short_pulse();
+  }
+#endif
+}
+
+// The scroll layer keeps UP and DOWN, they are reported when they scroll
+static void prv_info_click_config_provider(void *context) {
+  window_single_click_subscribe(BUTTON_ID_SELECT, prv_info_select_handler);
+}
+
+static void prv_info_scrolled(ScrollLayer *scroll_layer, void *context) {
+  activity_note();
+}
 
 static void prv_info_window_load(Window *window) {
   SettingsWindow *settings = window_get_user_data(window);
   Layer *window_layer = window_get_root_layer(window);
   GRect bounds = layer_get_bounds(window_layer);
   
-  // Create text layer for system info
-  settings->info_text_layer = text_layer_create(GRect(5, 10, bounds.size.w - 10, bounds.size.h - 20));
-  if (!settings->info_text_layer) {
-    APP_LOG(APP_LOG_LEVEL_ERROR, "Failed to create info text layer");
+  // Create scroll layer and text layer for system info
+  settings->info_scroll_layer = scroll_layer_create(bounds);
+  settings->info_text_layer = text_layer_create(GRect(INFO_MARGIN, 2 * INFO_MARGIN,
+                                                      bounds.size.w - 2 * INFO_MARGIN, INFO_TEXT_MAX_HEIGHT));
+  if (!settings->info_scroll_layer || !settings->info_text_layer) {
+    APP_LOG(APP_LOG_LEVEL_ERROR, "Failed to create info layers");
+    prv_info_window_unload(window);
     window_destroy(settings->info_window);
     settings->info_window = NULL;
     return;
   }
-  text_layer_set_font(settings->info_text_layer, fonts_get_system_font(FONT_KEY_GOTHIC_18));
+  text_layer_set_font(settings->info_text_layer, fonts_get_system_font(FONT_KEY_GOTHIC_14));
   text_layer_set_text_alignment(settings->info_text_layer, GTextAlignmentLeft);
   text_layer_set_overflow_mode(settings->info_text_layer, GTextOverflowModeWordWrap);
+  scroll_layer_add_child(settings->info_scroll_layer, text_layer_get_layer(settings->info_text_layer));
+  scroll_layer_set_callbacks(settings->info_scroll_layer, (ScrollLayerCallbacks){
+    .click_config_provider = prv_info_click_config_provider,
+    .content_offset_changed_handler = prv_info_scrolled,
+  });
+  scroll_layer_set_click_config_onto_window(settings->info_scroll_layer, window);
+  layer_add_child(window_layer, scroll_layer_get_layer(settings->info_scroll_layer));
   
-  // Format system information
-  static char info_buffer[256];
-  size_t heap_used = heap_bytes_used();
-  size_t heap_free = heap_bytes_free();
-  
-  snprintf(info_buffer, sizeof(info_buffer),
-    "Version: %s\n\n"
-    "Account count: %zu\n\n"
-    "Memory used: %zu B\n"
-    "Memory free: %zu B\n",
-    VERSION,
-    storage_get_count(),
-    heap_used,
-    heap_free
-  );
-  
-  text_layer_set_text(settings->info_text_layer, info_buffer);
-  layer_add_child(window_layer, text_layer_get_layer(settings->info_text_layer));
+  StorageUsage usage;
+  storage_get_usage(&usage);
+  settings->info_persist_used = usage.used;
+  settings->info_probed_at = 0;
+  prv_update_info(settings);
 }
 
 static void prv_info_window_unload(Window *window) {
   SettingsWindow *settings = window_get_user_data(window);
+  activity_note();  // BACK closed the window
+  
+  if (settings->info_timer) {
+    app_timer_cancel(settings->info_timer);
+    settings->info_timer = NULL;
+  }
   
   if (settings->info_text_layer) {
     text_layer_destroy(settings->info_text_layer);
     settings->info_text_layer = NULL;
   }
+  
+  if (settings->info_scroll_layer) {
+    scroll_layer_destroy(settings->info_scroll_layer);
+    settings->info_scroll_layer = NULL;
+  }
 }
 
 // ============================================================================
@@ -294,6 +542,7 @@ static void prv_window_load(Window *window) {
     .draw_header = prv_menu_draw_header_callback,
     .draw_row = prv_menu_draw_row_callback,
     .select_click = prv_menu_select_callback,
+    .selection_changed = prv_menu_selection_changed_callback,
   });
   
   menu_layer_set_click_config_onto_window(settings->menu_layer, window);
@@ -302,6 +551,7 @@ static void prv_window_load(Window *window) {
 
 static void prv_window_unload(Window *window) {
   SettingsWindow *settings = window_get_user_data(window);
+  activity_note();  // BACK closed the window
   
   // Only destroy menu_layer here, as it's created in prv_window_load
   if (settings->menu_layer) {
@@ -311,6 +561,7 @@ static void prv_window_unload(Window *window) {
   
   // Note: pin_window and info_window are NOT destroyed here
   // They are created on-demand and will be cleaned up in settings_window_destroy
+  memory_phase_end(MEMORY_PHASE_SETTINGS);
 }
 
 // ============================================================================
@@ -322,14 +573,14 @@ SettingsWindow* settings_window_create(void) {
     return s_settings_window;
   }
   
-  SettingsWindow *settings = malloc(sizeof(SettingsWindow));
+  SettingsWindow *settings = memory_malloc(sizeof(SettingsWindow));
   if (!settings) return NULL;
   
   memset(settings, 0, sizeof(SettingsWindow));
   
   settings->window = window_create();
   if (!settings->window) {
-    free(settings);
+    memory_free(settings);
     return NULL;
   }
   
@@ -367,7 +618,7 @@ void settings_window_destroy(SettingsWindow *settings_window) {
     s_settings_window = NULL;
   }
   
-  free(settings_window);
+  memory_free(settings_window);
 }
 
 void settings_window_push(SettingsWindow *settings_window, bool animated) {
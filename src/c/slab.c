@@ -0,0 +1,87 @@
+#include "slab.h"
+#include "memory.h"
+
+// Freed blocks are chained through their first bytes
+typedef struct SlabFreeBlock {
+  struct SlabFreeBlock *next;
+} SlabFreeBlock;
+
+struct Slab {
+  size_t block_size;
+  size_t block_count;
+  size_t next_unused;  // Blocks from here on have never been handed out
+  size_t used;
+  SlabFreeBlock *free_list;
+  uint8_t *blocks;
+};
+
+Slab* slab_create(size_t block_size, size_t block_count) {
+  if (block_count == 0) return NULL;
+
+  // Keep every block aligned for the free list pointer and 64-bit fields
+  size_t align = sizeof(uint64_t);
+  if (block_size < sizeof(SlabFreeBlock)) {
+    block_size = sizeof(SlabFreeBlock);
+  }
+  block_size = (block_size + align - 1) / align * align;
+
+  Slab *slab = memory_malloc(sizeof(Slab));
+  if (!slab) return NULL;
+
+  slab->blocks = memory_malloc(block_size * block_count);
+  if (!slab->blocks) {
+    memory_free(slab);
+    return NULL;
+  }
+  slab->block_size = block_size;
+  slab->block_count = block_count;
+  slab_reset(slab);
+  return slab;
+}
+
+void slab_destroy(Slab *slab) {
+  if (!slab) return;
+  memory_free(slab->blocks);
+  memory_free(slab);
+}
+
+void* slab_alloc(Slab *slab) {
+  if (!slab) return NULL;
+
+  void *block = NULL;
+  if (slab->free_list) {
+    block = slab->free_list;
+    slab->free_list = slab->free_list->next;
+  } else if (slab->next_unused < slab->block_count) {
+    block = slab->blocks + slab->next_unused * slab->block_size;
+    slab->next_unused++;
+  } else {
+    return NULL;
+  }
+  slab->used++;
+  return block;
+}
+
+void slab_free(Slab *slab, void *block) {
+  if (!slab || !block) return;
+
+  SlabFreeBlock *free_block = block;
+  free_block->next = slab->free_list;
+  slab->free_list = free_block;
+  slab->used--;
+}
+
+void slab_reset(Slab *slab) {
+  if (!slab) return;
+  slab->next_unused = 0;
+  slab->used = 0;
+  slab->free_list = NULL;
+}
+
+size_t slab_get_capacity(const Slab *slab) {
+  return slab ? slab->block_count : 0;
+}
+
+size_t slab_get_used(const Slab *slab) {
+  return slab ? slab->used : 0;
+}
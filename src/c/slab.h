@@ -0,0 +1,24 @@
+#pragma once
+
+#include <pebble.h>
+
+// Fixed-size block allocator backed by a single heap allocation.
+// Blocks are handed out from a free list, so allocating and freeing
+// never touch the system heap and can't fragment it.
+typedef struct Slab Slab;
+
+// Allocate a slab of block_count blocks of block_size bytes, NULL if out of memory
+Slab* slab_create(size_t block_size, size_t block_count);
+void slab_destroy(Slab *slab);
+
+// Take a block from the slab, NULL if all blocks are in use
+void* slab_alloc(Slab *slab);
+
+// Return a block taken from this slab
+void slab_free(Slab *slab, void *block);
+
+// Return all blocks at once, in constant time
+void slab_reset(Slab *slab);
+
+size_t slab_get_capacity(const Slab *slab);
+size_t slab_get_used(const Slab *slab);
@@ -1,8 +1,16 @@
 #include "storage.h"
 #include "ui.h"
 #include "config.h"
+#include "profile.h"
+#include "trace.h"
+#include "memory.h"
 #include <string.h>
+#include <stddef.h>
 
+#define ACCOUNT_RECORD_VERSION 3
+#define ACCOUNT_RECORD_VERSION_2 2  // Before uid and type, still accepted on load
+
+// Fixed-size record written by older versions, still accepted on load
 typedef struct {
   char label[LABEL_MAX_LEN + 1];
   char account_name[ACCOUNT_NAME_MAX_LEN + 1];
@@ -11,7 +19,193 @@ typedef struct {
   uint16_t period;
   uint8_t digits;
   uint8_t algorithm;  // TotpAlgorithm
-} __attribute__((__packed__)) PersistedAccount;
+} __attribute__((__packed__)) LegacyPersistedAccount;
+
+typedef struct {
+  uint8_t version;  // ACCOUNT_RECORD_VERSION, never a valid first label char
+  uint32_t hash;    // CRC32 of everything after this field
+  uint32_t uid;     // See prv_account_uid
+  uint16_t period;
+  uint8_t digits;
+  uint8_t algorithm;  // TotpAlgorithm
+  uint8_t type;       // OtpType
+  uint8_t label_len;
+  uint8_t account_name_len;
+  uint8_t secret_len;
+} __attribute__((__packed__)) AccountRecordHeader;
+
+// Header followed by label, account name, secret and for HOTP the initial
+// counter, only used bytes are stored
+typedef struct {
+  AccountRecordHeader header;
+  uint8_t payload[LABEL_MAX_LEN + ACCOUNT_NAME_MAX_LEN + SECRET_BYTES_MAX + sizeof(uint64_t)];
+} __attribute__((__packed__)) AccountRecord;
+
+#define ACCOUNT_RECORD_HASHED_OFFSET (offsetof(AccountRecordHeader, hash) + sizeof(uint32_t))
+
+// Version 2 header, the payload is label, account name and secret
+typedef struct {
+  uint8_t version;  // ACCOUNT_RECORD_VERSION_2
+  uint32_t hash;    // CRC32 of everything after this field
+  uint16_t period;
+  uint8_t digits;
+  uint8_t algorithm;  // TotpAlgorithm
+  uint8_t label_len;
+  uint8_t account_name_len;
+  uint8_t secret_len;
+} __attribute__((__packed__)) AccountRecordHeaderV2;
+
+#define CRC32_INIT 0xFFFFFFFF
+
+// CRC32 (IEEE 802.3), bitwise to keep the table out of RAM
+static uint32_t prv_crc32_update(uint32_t crc, const uint8_t *data, size_t len) {
+  for (size_t i = 0; i < len; i++) {
+    crc ^= data[i];
+    for (int bit = 0; bit < 8; bit++) {
+      crc = (crc >> 1) ^ (0xEDB88320 & (uint32_t)(-(int32_t)(crc & 1)));
+    }
+  }
+  return crc;
+}
+
+static uint32_t prv_crc32(const uint8_t *data, size_t len) {
+  return ~prv_crc32_update(CRC32_INIT, data, len);
+}
+
+// Stored size of a record, the one place that knows the payload layout
+static size_t prv_layout_size(uint8_t type, size_t label_len, size_t account_name_len, size_t secret_len) {
+  return sizeof(AccountRecordHeader) + label_len + account_name_len + secret_len +
+         (type == OTP_TYPE_HOTP ? sizeof(uint64_t) : 0);
+}
+
+static size_t prv_record_size(const AccountRecord *record) {
+  return prv_layout_size(record->header.type, record->header.label_len,
+                         record->header.account_name_len, record->header.secret_len);
+}
+
+static uint32_t prv_record_hash(const AccountRecord *record) {
+  const uint8_t *bytes = (const uint8_t *)record;
+  return prv_crc32(bytes + ACCOUNT_RECORD_HASHED_OFFSET,
+                   prv_record_size(record) - ACCOUNT_RECORD_HASHED_OFFSET);
+}
+
+static uint8_t prv_bounded_strlen(const char *str, size_t max_len) {
+  size_t len = strlen(str);
+  return (uint8_t)(len > max_len ? max_len : len);
+}
+
+// Identifies an account across syncs and reorders, accounts sharing a
+// secret still get their own. HOTP counters go by the secret instead. Strings are hashed with their terminator so
+// moving bytes between label and account name changes the uid.
+static uint32_t prv_account_uid(const TotpAccount *account) {
+  size_t secret_len = account->secret_len > SECRET_BYTES_MAX ? SECRET_BYTES_MAX : account->secret_len;
+  uint32_t crc = CRC32_INIT;
+  crc = prv_crc32_update(crc, (const uint8_t *)account->label,
+                         prv_bounded_strlen(account->label, LABEL_MAX_LEN) + 1);
+  crc = prv_crc32_update(crc, (const uint8_t *)account->account_name,
+                         prv_bounded_strlen(account->account_name, ACCOUNT_NAME_MAX_LEN) + 1);
+  crc = prv_crc32_update(crc, account->secret, secret_len);
+  return ~crc;
+}
+
+static void prv_pack_record(const TotpAccount *account, AccountRecord *record) {
+  memset(record, 0, sizeof(*record));
+  record->header.version = ACCOUNT_RECORD_VERSION;
+  record->header.uid = prv_account_uid(account);
+  record->header.period = account->period;
+  record->header.digits = account->digits;
+  record->header.algorithm = account->algorithm;
+  record->header.type = account->type == OTP_TYPE_HOTP ? OTP_TYPE_HOTP : OTP_TYPE_TOTP;
+  record->header.label_len = prv_bounded_strlen(account->label, LABEL_MAX_LEN);
+  record->header.account_name_len = prv_bounded_strlen(account->account_name, ACCOUNT_NAME_MAX_LEN);
+  record->header.secret_len = account->secret_len > SECRET_BYTES_MAX ? SECRET_BYTES_MAX : account->secret_len;
+
+  uint8_t *ptr = record->payload;
+  memcpy(ptr, account->label, record->header.label_len);
+  ptr += record->header.label_len;
+  memcpy(ptr, account->account_name, record->header.account_name_len);
+  ptr += record->header.account_name_len;
+  memcpy(ptr, account->secret, record->header.secret_len);
+  ptr += record->header.secret_len;
+  if (record->header.type == OTP_TYPE_HOTP) {
+    memcpy(ptr, &account->counter, sizeof(account->counter));
+  }
+
+  record->header.hash = prv_record_hash(record);
+}
+
+static bool prv_unpack_record(const AccountRecord *record, size_t size, TotpAccount *account) {
+  if (size < sizeof(AccountRecordHeader) ||
+      record->header.label_len > LABEL_MAX_LEN ||
+      record->header.account_name_len > ACCOUNT_NAME_MAX_LEN ||
+      record->header.secret_len > SECRET_BYTES_MAX ||
+      prv_record_size(record) != size ||
+      prv_record_hash(record) != record->header.hash) {
+    return false;
+  }
+
+  memset(account, 0, sizeof(*account));
+  const uint8_t *ptr = record->payload;
+  memcpy(account->label, ptr, record->header.label_len);
+  ptr += record->header.label_len;
+  memcpy(account->account_name, ptr, record->header.account_name_len);
+  ptr += record->header.account_name_len;
+  memcpy(account->secret, ptr, record->header.secret_len);
+  ptr += record->header.secret_len;
+  account->secret_len = record->header.secret_len;
+  account->period = record->header.period;
+  account->digits = record->header.digits;
+  account->algorithm = record->header.algorithm;
+  account->type = record->header.type;
+  if (account->type == OTP_TYPE_HOTP) {
+    memcpy(&account->counter, ptr, sizeof(account->counter));
+  }
+  return true;
+}
+
+static bool prv_unpack_record_v2(const uint8_t *data, size_t size, TotpAccount *account) {
+  AccountRecordHeaderV2 header;
+  if (size < sizeof(header)) {
+    return false;
+  }
+  memcpy(&header, data, sizeof(header));
+  size_t hashed_offset = offsetof(AccountRecordHeaderV2, hash) + sizeof(uint32_t);
+  if (header.label_len > LABEL_MAX_LEN ||
+      header.account_name_len > ACCOUNT_NAME_MAX_LEN ||
+      header.secret_len > SECRET_BYTES_MAX ||
+      sizeof(header) + header.label_len + header.account_name_len + header.secret_len != size ||
+      prv_crc32(data + hashed_offset, size - hashed_offset) != header.hash) {
+    return false;
+  }
+
+  memset(account, 0, sizeof(*account));
+  const uint8_t *ptr = data + sizeof(header);
+  memcpy(account->label, ptr, header.label_len);
+  ptr += header.label_len;
+  memcpy(account->account_name, ptr, header.account_name_len);
+  ptr += header.account_name_len;
+  memcpy(account->secret, ptr, header.secret_len);
+  account->secret_len = header.secret_len;
+  account->period = header.period;
+  account->digits = header.digits;
+  account->algorithm = header.algorithm;
+  account->type = OTP_TYPE_TOTP;
+  return true;
+}
+
+static void prv_unpack_legacy(const LegacyPersistedAccount *data, TotpAccount *account) {
+  memset(account, 0, sizeof(*account));
+  strncpy(account->label, data->label, sizeof(account->label) - 1);
+  strncpy(account->account_name, data->account_name, sizeof(account->account_name) - 1);
+  account->secret_len = data->secret_len;
+  if (account->secret_len > SECRET_BYTES_MAX) {
+    account->secret_len = SECRET_BYTES_MAX;
+  }
+  memcpy(account->secret, data->secret, account->secret_len);
+  account->period = data->period;
+  account->digits = data->digits;
+  account->algorithm = data->algorithm;
+}
 
 #ifdef DEBUG
 // Create fake account for debug mode
@@ -83,23 +277,218 @@ static void prv_create_fake_account(size_t id, TotpAccount *account) {
 }
 #endif
 
+// ============================================================================
+// Account banks
+// ============================================================================
+//
+// Records live in a pool of slots (PERSIST_KEY_ACCOUNTS_START + slot). Each
+// of the two banks is an index mapping account IDs to slots, and
+// PERSIST_KEY_ACTIVE_BANK selects which one is live. A sync builds the index
+// in the inactive bank, reusing slots of unchanged records and writing
+// changed ones to free slots, then switches banks with a single write.
+
+#define SLOT_NONE 0xFF
+#define LEGACY_BANK 0xFF
+
+typedef struct {
+  uint8_t count;
+  uint8_t slots[STORAGE_MAX_ACCOUNTS];
+} __attribute__((__packed__)) BankIndex;
+
+typedef struct {
+  BankIndex index;
+  uint32_t active_hashes[STORAGE_MAX_ACCOUNTS];  // by ID in the active bank
+  uint8_t hashed[(STORAGE_MAX_ACCOUNTS + 7) / 8];  // IDs whose hash could be read
+  uint8_t used_slots[(STORAGE_MAX_SLOTS + 7) / 8];
+  size_t free_bytes;  // Persist left for records that need a new slot
+} SyncStaging;
+
+static uint8_t s_active_bank = LEGACY_BANK;
+static BankIndex s_active_index;
+static bool s_index_loaded = false;
+static SyncStaging *s_staging = NULL;
+
+static uint32_t prv_slot_key(uint8_t slot) {
+  return PERSIST_KEY_ACCOUNTS_START + slot;
+}
+
+static uint32_t prv_bank_key(uint8_t bank) {
+  return bank ? PERSIST_KEY_BANK_INDEX_1 : PERSIST_KEY_BANK_INDEX_0;
+}
+
+static void prv_load_index(void) {
+  if (s_index_loaded) return;
+  s_index_loaded = true;
+
+  memset(&s_active_index, 0, sizeof(s_active_index));
+  if (persist_exists(PERSIST_KEY_ACTIVE_BANK)) {
+    s_active_bank = persist_read_int(PERSIST_KEY_ACTIVE_BANK) ? 1 : 0;
+    persist_read_data(prv_bank_key(s_active_bank), &s_active_index, sizeof(s_active_index));
+    if (s_active_index.count > STORAGE_MAX_ACCOUNTS) {
+      s_active_index.count = 0;
+    }
+    return;
+  }
+
+  // Accounts written before banks existed: ID N lives in slot N
+  s_active_bank = LEGACY_BANK;
+  if (persist_exists(PERSIST_KEY_COUNT)) {
+    size_t count = (size_t)persist_read_int(PERSIST_KEY_COUNT);
+    s_active_index.count = count > STORAGE_MAX_ACCOUNTS ? STORAGE_MAX_ACCOUNTS : count;
+  }
+  for (size_t i = 0; i < s_active_index.count; i++) {
+    s_active_index.slots[i] = i;
+  }
+}
+
+static size_t prv_slot_limit(void) {
+  if (!persist_exists(PERSIST_KEY_SLOT_LIMIT)) {
+    return STORAGE_MAX_SLOTS;
+  }
+  size_t limit = (size_t)persist_read_int(PERSIST_KEY_SLOT_LIMIT);
+  return limit > STORAGE_MAX_SLOTS ? STORAGE_MAX_SLOTS : limit;
+}
+
+static void prv_set_slot_limit(size_t limit) {
+  if (persist_exists(PERSIST_KEY_SLOT_LIMIT) && (size_t)persist_read_int(PERSIST_KEY_SLOT_LIMIT) == limit) {
+    return;
+  }
+  persist_write_int(PERSIST_KEY_SLOT_LIMIT, limit);
+}
+
+static bool prv_read_slot(uint8_t slot, TotpAccount *account) {
+  uint32_t key = prv_slot_key(slot);
+  if (!persist_exists(key)) {
+    return false;
+  }
+
+  // Big enough for both the current and the legacy layout
+  union {
+    AccountRecord record;
+    LegacyPersistedAccount legacy;
+  } data;
+  TRACE_BEGIN(TRACE_PERSIST_READ, key);
+  int size = persist_read_data(key, &data, sizeof(data));
+  TRACE_END(TRACE_PERSIST_READ, key);
+  if (size <= 0) {
+    return false;
+  }
+
+  if (data.record.header.version == ACCOUNT_RECORD_VERSION) {
+    if (!prv_unpack_record(&data.record, (size_t)size, account)) {
+      APP_LOG(APP_LOG_LEVEL_WARNING, "Account slot %d is corrupted", (int)slot);
+      return false;
+    }
+  } else if (data.record.header.version == ACCOUNT_RECORD_VERSION_2) {
+    if (!prv_unpack_record_v2((const uint8_t *)&data, (size_t)size, account)) {
+      APP_LOG(APP_LOG_LEVEL_WARNING, "Account slot %d is corrupted", (int)slot);
+      return false;
+    }
+  } else if ((size_t)size == sizeof(LegacyPersistedAccount)) {
+    prv_unpack_legacy(&data.legacy, account);
+  } else {
+    return false;
+  }
+
+  if (account->period == 0) {
+    account->period = DEFAULT_PERIOD;
+  }
+  if (account->digits < MIN_DIGITS || account->digits > MAX_DIGITS) {
+    account->digits = DEFAULT_DIGITS;
+  }
+  if (account->algorithm > TOTP_ALGO_SHA512) {
+    account->algorithm = TOTP_ALGO_SHA1;
+  }
+  if (account->type > OTP_TYPE_HOTP) {
+    account->type = OTP_TYPE_TOTP;
+  }
+
+  return true;
+}
+
+// Content hash of the record in a slot, false if it can't be read
+static bool prv_slot_hash(uint8_t slot, uint32_t *out_hash) {
+  AccountRecordHeader header;
+  if (persist_read_data(prv_slot_key(slot), &header, sizeof(header)) != sizeof(header)) {
+    return false;
+  }
+  if (header.version == ACCOUNT_RECORD_VERSION) {
+    *out_hash = header.hash;
+    return true;
+  }
+
+  // Older layout, hash what it would be stored as now
+  TotpAccount account;
+  AccountRecord record;
+  if (!prv_read_slot(slot, &account)) {
+    return false;
+  }
+  prv_pack_record(&account, &record);
+  *out_hash = record.header.hash;
+  return true;
+}
+
+// Whether a slot holds exactly this record, hashes only narrow down the candidates
+static bool prv_slot_holds(uint8_t slot, const AccountRecord *record) {
+  uint32_t key = prv_slot_key(slot);
+  size_t size = prv_record_size(record);
+
+  AccountRecord stored;
+  int read = persist_read_data(key, &stored, sizeof(stored));
+  if (read < (int)sizeof(AccountRecordHeader)) {
+    return false;
+  }
+  if (stored.header.version != ACCOUNT_RECORD_VERSION) {
+    // Older layout, compare with what it would be stored as now
+    TotpAccount account;
+    if (!prv_read_slot(slot, &account)) {
+      return false;
+    }
+    prv_pack_record(&account, &stored);
+    read = (int)prv_record_size(&stored);
+  }
+  return read == (int)size && memcmp(&stored, record, size) == 0;
+}
+
+static bool prv_write_slot(uint8_t slot, const AccountRecord *record) {
+  uint32_t key = prv_slot_key(slot);
+  size_t size = prv_record_size(record);
+
+  // Skip the flash write if the slot already holds the same record
+  if (persist_get_size(key) == (int)size) {
+    AccountRecordHeader stored;
+    if (persist_read_data(key, &stored, sizeof(stored)) == sizeof(stored) &&
+        stored.version == ACCOUNT_RECORD_VERSION &&
+        stored.hash == record->header.hash &&
+        prv_slot_holds(slot, record)) {
+      return true;
+    }
+  }
+
+  TRACE_BEGIN(TRACE_PERSIST_WRITE, key);
+  bool written = persist_write_data(key, record, size) == (int)size;
+  TRACE_END(TRACE_PERSIST_WRITE, key);
+  return written;
+}
+
+static bool prv_slot_is_used(const uint8_t *bitmap, uint8_t slot) {
+  return bitmap[slot / 8] & (1 << (slot % 8));
+}
+
+static void prv_mark_slot_used(uint8_t *bitmap, uint8_t slot) {
+  bitmap[slot / 8] |= 1 << (slot % 8);
+}
+
 // Get account count
 size_t storage_get_count(void) {
 #ifdef DEBUG
   return DEBUG_ACCOUNTS;
 #else
-  if (!persist_exists(PERSIST_KEY_COUNT)) {
-    return 0;
-  }
-  return (size_t)persist_read_int(PERSIST_KEY_COUNT);
+  prv_load_index();
+  return s_active_index.count;
 #endif
 }
 
-// Set account count
-void storage_set_count(size_t count) {
-  persist_write_int(PERSIST_KEY_COUNT, count);
-}
-
 // Load account by ID
 bool storage_load_account(size_t id, TotpAccount *account) {
   if (!account) return false;
@@ -111,57 +500,711 @@ bool storage_load_account(size_t id, TotpAccount *account) {
   prv_create_fake_account(id, account);
   return true;
 #else
-  uint32_t key = PERSIST_KEY_ACCOUNTS_START + id;
-  if (!persist_exists(key)) {
+  prv_load_index();
+  if (id >= s_active_index.count) {
     return false;
   }
+  PROFILE_START(start);
+  bool loaded = prv_read_slot(s_active_index.slots[id], account);
+  PROFILE_STOP(PROFILE_LOAD_ACCOUNT, start);
+  return loaded;
+#endif
+}
 
-  PersistedAccount data;
-  persist_read_data(key, &data, sizeof(data));
+static void prv_fill_info(const TotpAccount *account, AccountInfo *info) {
+  info->uid = prv_account_uid(account);
+  info->period = account->period;
+  info->digits = account->digits;
+  info->algorithm = account->algorithm;
+  info->type = account->type;
+  info->has_account_name = account->account_name[0] != '\0';
+  info->initial = storage_label_initial(account->label);
+}
 
-  memset(account, 0, sizeof(*account));
-  strncpy(account->label, data.label, sizeof(account->label) - 1);
-  strncpy(account->account_name, data.account_name, sizeof(account->account_name) - 1);
-  account->secret_len = data.secret_len;
-  if (account->secret_len > SECRET_BYTES_MAX) {
-    account->secret_len = SECRET_BYTES_MAX;
+char storage_label_initial(const char *label) {
+  char c = label[0];
+  if (c >= 'a' && c <= 'z') return c - 'a' + 'A';
+  if (c >= 'A' && c <= 'Z') return c;
+  return '#';
+}
+
+// Load account metadata by ID, reads only the record header
+bool storage_load_account_info(size_t id, AccountInfo *info) {
+  if (!info) return false;
+
+#ifdef DEBUG
+  TotpAccount account;
+  if (!storage_load_account(id, &account)) {
+    return false;
+  }
+  prv_fill_info(&account, info);
+  return true;
+#else
+  prv_load_index();
+  if (id >= s_active_index.count) {
+    return false;
+  }
+
+  // The header and the first label byte for the jump index
+  uint8_t slot = s_active_index.slots[id];
+  uint8_t buffer[sizeof(AccountRecordHeader) + 1];
+  TRACE_BEGIN(TRACE_PERSIST_READ, prv_slot_key(slot));
+  int read = persist_read_data(prv_slot_key(slot), buffer, sizeof(buffer));
+  TRACE_END(TRACE_PERSIST_READ, prv_slot_key(slot));
+  if (read < (int)sizeof(AccountRecordHeader)) {
+    return false;
+  }
+  AccountRecordHeader header;
+  memcpy(&header, buffer, sizeof(header));
+  if (header.version != ACCOUNT_RECORD_VERSION) {
+    // Older layout, the whole thing has to be read
+    TotpAccount account;
+    if (!prv_read_slot(slot, &account)) {
+      return false;
+    }
+    prv_fill_info(&account, info);
+    return true;
   }
-  memcpy(account->secret, data.secret, account->secret_len);
-  account->period = data.period > 0 ? data.period : DEFAULT_PERIOD;
-  account->digits = data.digits >= MIN_DIGITS && data.digits <= MAX_DIGITS ? data.digits : DEFAULT_DIGITS;
-  account->algorithm = (data.algorithm <= TOTP_ALGO_SHA512) ? data.algorithm : TOTP_ALGO_SHA1;
 
+  info->uid = header.uid;
+  info->period = header.period > 0 ? header.period : DEFAULT_PERIOD;
+  info->digits = header.digits >= MIN_DIGITS && header.digits <= MAX_DIGITS ? header.digits : DEFAULT_DIGITS;
+  info->algorithm = header.algorithm <= TOTP_ALGO_SHA512 ? header.algorithm : TOTP_ALGO_SHA1;
+  info->type = header.type <= OTP_TYPE_HOTP ? header.type : OTP_TYPE_TOTP;
+  info->has_account_name = header.account_name_len > 0;
+  char label[2] = { 0 };
+  if (header.label_len > 0 && read > (int)sizeof(AccountRecordHeader)) {
+    label[0] = buffer[sizeof(AccountRecordHeader)];
+  }
+  info->initial = storage_label_initial(label);
   return true;
 #endif
 }
 
-// Save account by ID
-bool storage_save_account(size_t id, const TotpAccount *account) {
-  if (!account) return false;
+// Load account count from storage
+void storage_load_accounts(void) {
+  s_total_account_count = storage_get_count();
+}
+
+// Start staging a new account list into the inactive bank
+bool storage_sync_begin(size_t count) {
+  storage_sync_abort();
+  if (count > STORAGE_MAX_ACCOUNTS) {
+    return false;
+  }
+
+  // Leftovers of an interrupted sync would take space the staged records need
+  storage_collect_garbage();
+
+  s_staging = memory_malloc(sizeof(SyncStaging));
+  if (!s_staging) {
+    return false;
+  }
+  memset(s_staging, 0, sizeof(SyncStaging));
+  s_staging->index.count = count;
+  memset(s_staging->index.slots, SLOT_NONE, sizeof(s_staging->index.slots));
 
-  PersistedAccount data;
-  memset(&data, 0, sizeof(data));
-  strncpy(data.label, account->label, sizeof(data.label) - 1);
-  strncpy(data.account_name, account->account_name, sizeof(data.account_name) - 1);
-  data.secret_len = account->secret_len;
-  memcpy(data.secret, account->secret, account->secret_len);
-  data.period = account->period;
-  data.digits = account->digits;
-  data.algorithm = account->algorithm;
+  // Slots of the live list must not be touched until the banks are switched
+  prv_load_index();
+  for (size_t i = 0; i < s_active_index.count; i++) {
+    uint8_t slot = s_active_index.slots[i];
+    prv_mark_slot_used(s_staging->used_slots, slot);
+    if (prv_slot_hash(slot, &s_staging->active_hashes[i])) {
+      prv_mark_slot_used(s_staging->hashed, i);
+    }
+  }
 
-  uint32_t key = PERSIST_KEY_ACCOUNTS_START + id;
-  return persist_write_data(key, &data, sizeof(data)) == sizeof(data);
+  // New records go next to the live ones, the staged bank index replaces
+  // the inactive one when committing
+  StorageUsage usage;
+  storage_get_usage(&usage);
+  int inactive_index = persist_get_size(prv_bank_key(s_active_bank == 0 ? 1 : 0));
+  size_t available = usage.free + (inactive_index > 0 ? (size_t)inactive_index : 0);
+  size_t index_size = sizeof(s_staging->index.count) + count;
+  s_staging->free_bytes = available > index_size ? available - index_size : 0;
+  return true;
 }
 
-// Delete account by ID
-void storage_delete_account(size_t id) {
-  uint32_t key = PERSIST_KEY_ACCOUNTS_START + id;
-  persist_delete(key);
+// Whether the live record of an ID can stand in for a staged one
+static bool prv_reusable(size_t active_id, const AccountRecord *record) {
+  return prv_slot_is_used(s_staging->hashed, active_id) &&
+         s_staging->active_hashes[active_id] == record->header.hash &&
+         prv_slot_holds(s_active_index.slots[active_id], record);
 }
 
-// Load account count from storage
-void storage_load_accounts(void) {
-  s_total_account_count = storage_get_count();
+// Stage account by ID, reusing a live record with the same content if there is one
+bool storage_sync_save_account(size_t id, const TotpAccount *account) {
+  if (!s_staging || !account || id >= s_staging->index.count) return false;
+
+  AccountRecord record;
+  prv_pack_record(account, &record);
+
+  // Same ID first, then anywhere else in the live list (reordered accounts)
+  if (id < s_active_index.count && prv_reusable(id, &record)) {
+    s_staging->index.slots[id] = s_active_index.slots[id];
+    return true;
+  }
+  for (size_t i = 0; i < s_active_index.count; i++) {
+    if (i != id && prv_reusable(i, &record)) {
+      s_staging->index.slots[id] = s_active_index.slots[i];
+      return true;
+    }
+  }
+
+  size_t size = prv_record_size(&record);
+  if (size > s_staging->free_bytes) {
+    APP_LOG(APP_LOG_LEVEL_WARNING, "No space for account %d", (int)id);
+    return false;
+  }
+
+  uint8_t slot = 0;
+  while (slot < STORAGE_MAX_SLOTS && prv_slot_is_used(s_staging->used_slots, slot)) {
+    slot++;
+  }
+  if (slot >= STORAGE_MAX_SLOTS) {
+    APP_LOG(APP_LOG_LEVEL_ERROR, "No free account slot");
+    return false;
+  }
+
+  // Raise the limit first so an interrupted sync is still found by the GC
+  if ((size_t)slot >= prv_slot_limit()) {
+    prv_set_slot_limit(slot + 1);
+  }
+  if (!prv_write_slot(slot, &record)) {
+    return false;
+  }
+  prv_mark_slot_used(s_staging->used_slots, slot);
+  s_staging->index.slots[id] = slot;
+  s_staging->free_bytes -= size;
+  return true;
+}
+
+// Switch to the staged list once every account has been received
+bool storage_sync_commit(void) {
+  if (!s_staging) return false;
+
+  for (size_t i = 0; i < s_staging->index.count; i++) {
+    if (s_staging->index.slots[i] == SLOT_NONE) {
+      return false;
+    }
+  }
+
+  bool changed = s_active_bank == LEGACY_BANK ||
+                 s_staging->index.count != s_active_index.count ||
+                 memcmp(s_staging->index.slots, s_active_index.slots, s_active_index.count) != 0;
+  if (changed) {
+    uint8_t bank = s_active_bank == 0 ? 1 : 0;
+    size_t size = sizeof(s_staging->index.count) + s_staging->index.count;
+    TRACE_BEGIN(TRACE_PERSIST_WRITE, prv_bank_key(bank));
+    bool written = persist_write_data(prv_bank_key(bank), &s_staging->index, size) == (int)size;
+    TRACE_END(TRACE_PERSIST_WRITE, prv_bank_key(bank));
+    if (!written) {
+      storage_sync_abort();
+      return false;
+    }
+    // Single write, the live list is either fully old or fully new. Until
+    // it lands the old bank stays live, also for the GC.
+    TRACE_BEGIN(TRACE_PERSIST_WRITE, PERSIST_KEY_ACTIVE_BANK);
+    written = persist_write_int(PERSIST_KEY_ACTIVE_BANK, bank) == (int)sizeof(int32_t);
+    TRACE_END(TRACE_PERSIST_WRITE, PERSIST_KEY_ACTIVE_BANK);
+    if (!written) {
+      APP_LOG(APP_LOG_LEVEL_ERROR, "Failed to switch to bank %d", (int)bank);
+      storage_sync_abort();
+      return false;
+    }
+    s_active_bank = bank;
+    s_active_index = s_staging->index;
+  }
+
+  storage_sync_abort();
+  return true;
+}
+
+// Drop a partially staged list, the live list stays as it is
+void storage_sync_abort(void) {
+  if (s_staging) {
+    memory_free(s_staging);
+    s_staging = NULL;
+  }
+}
+
+// ============================================================================
+// HOTP counters
+// ============================================================================
+//
+// The next counter of each HOTP account is kept in RAM. Persist only holds
+// the end of the block of values reserved so far, so a block is written once
+// per HOTP_COUNTER_BLOCK codes. After a restart counting resumes from the
+// end of the reserved block, unused values are skipped but never repeated.
+//
+// Counters are keyed by the secret, the one thing that decides which codes
+// a server has seen. Renaming an account or removing it for a while keeps
+// its counter. Entries of secrets that left the list are only dropped when
+// the table is full and a new secret needs one.
+
+typedef struct {
+  uint32_t secret_id;  // See prv_secret_id
+  uint64_t reserved;   // First counter value not reserved yet
+} __attribute__((__packed__)) PersistedHotpCounter;
+
+typedef struct {
+  uint8_t count;
+  PersistedHotpCounter entries[HOTP_MAX_COUNTERS];
+} __attribute__((__packed__)) HotpCounterTable;
+
+static HotpCounterTable s_hotp_table;
+static uint64_t s_hotp_next[HOTP_MAX_COUNTERS];
+static bool s_hotp_loaded = false;
+
+static uint32_t prv_secret_id(const TotpAccount *account) {
+  size_t secret_len = account->secret_len > SECRET_BYTES_MAX ? SECRET_BYTES_MAX : account->secret_len;
+  return prv_crc32(account->secret, secret_len);
+}
+
+// Uids and secret IDs of the HOTP accounts in the live list, returns how many
+static size_t prv_live_hotp_ids(uint32_t *uids, uint32_t *secret_ids) {
+  prv_load_index();
+  size_t count = 0;
+  for (size_t i = 0; i < s_active_index.count; i++) {
+    // Only the current layout has HOTP records, the header tells which
+    AccountRecordHeader header;
+    TotpAccount account;
+    if (persist_read_data(prv_slot_key(s_active_index.slots[i]), &header, sizeof(header)) == sizeof(header) &&
+        header.version == ACCOUNT_RECORD_VERSION && header.type == OTP_TYPE_HOTP &&
+        prv_read_slot(s_active_index.slots[i], &account)) {
+      uids[count] = header.uid;
+      secret_ids[count] = prv_secret_id(&account);
+      count++;
+    }
+  }
+  return count;
+}
+
+static bool prv_save_hotp_counters(void) {
+  size_t size = sizeof(s_hotp_table.count) + s_hotp_table.count * sizeof(PersistedHotpCounter);
+  return persist_write_data(PERSIST_KEY_HOTP_COUNTERS, &s_hotp_table, size) == (int)size;
+}
+
+// Tables written before counters had their own key used the uid, which
+// hashed only the secret before record version 3 and the label and account
+// name too since. Entries of live accounts are moved over.
+static void prv_migrate_hotp_counters(void) {
+  HotpCounterTable old;
+  memset(&old, 0, sizeof(old));
+  persist_read_data(PERSIST_KEY_HOTP_COUNTERS_BY_UID, &old, sizeof(old));
+  if (old.count > HOTP_MAX_COUNTERS) {
+    old.count = 0;
+  }
+
+  uint32_t uids[STORAGE_MAX_ACCOUNTS];
+  uint32_t secret_ids[STORAGE_MAX_ACCOUNTS];
+  size_t live = prv_live_hotp_ids(uids, secret_ids);
+  for (size_t i = 0; i < old.count; i++) {
+    for (size_t j = 0; j < live; j++) {
+      if (old.entries[i].secret_id != uids[j] && old.entries[i].secret_id != secret_ids[j]) continue;
+
+      // Accounts sharing a secret keep the highest reservation
+      size_t k = 0;
+      while (k < s_hotp_table.count && s_hotp_table.entries[k].secret_id != secret_ids[j]) {
+        k++;
+      }
+      if (k == s_hotp_table.count) {
+        s_hotp_table.entries[k].secret_id = secret_ids[j];
+        s_hotp_table.entries[k].reserved = 0;
+        s_hotp_table.count++;
+      }
+      if (old.entries[i].reserved > s_hotp_table.entries[k].reserved) {
+        s_hotp_table.entries[k].reserved = old.entries[i].reserved;
+      }
+      break;
+    }
+  }
+
+  if (s_hotp_table.count == 0 || prv_save_hotp_counters()) {
+    persist_delete(PERSIST_KEY_HOTP_COUNTERS_BY_UID);
+  }
+}
+
+static void prv_load_hotp_counters(void) {
+  if (s_hotp_loaded) return;
+  s_hotp_loaded = true;
+
+  memset(&s_hotp_table, 0, sizeof(s_hotp_table));
+  if (persist_exists(PERSIST_KEY_HOTP_COUNTERS_BY_UID)) {
+    prv_migrate_hotp_counters();
+  } else {
+    persist_read_data(PERSIST_KEY_HOTP_COUNTERS, &s_hotp_table, sizeof(s_hotp_table));
+  }
+  if (s_hotp_table.count > HOTP_MAX_COUNTERS) {
+    s_hotp_table.count = 0;
+  }
+  for (size_t i = 0; i < s_hotp_table.count; i++) {
+    s_hotp_next[i] = s_hotp_table.entries[i].reserved;
+  }
+}
+
+// Entry for a new secret, replacing one whose secret left the list if the table is full
+static bool prv_add_hotp_counter(uint32_t secret_id, uint64_t counter, size_t *out_index) {
+  size_t i = s_hotp_table.count;
+  if (i >= HOTP_MAX_COUNTERS) {
+    uint32_t uids[STORAGE_MAX_ACCOUNTS];
+    uint32_t secret_ids[STORAGE_MAX_ACCOUNTS];
+    size_t live = prv_live_hotp_ids(uids, secret_ids);
+    for (i = 0; i < s_hotp_table.count; i++) {
+      bool is_live = false;
+      for (size_t j = 0; j < live && !is_live; j++) {
+        is_live = secret_ids[j] == s_hotp_table.entries[i].secret_id;
+      }
+      if (!is_live) break;
+    }
+    if (i >= s_hotp_table.count) {
+      APP_LOG(APP_LOG_LEVEL_ERROR, "Too many HOTP accounts");
+      return false;
+    }
+  } else {
+    s_hotp_table.count++;
+  }
+
+  s_hotp_table.entries[i].secret_id = secret_id;
+  s_hotp_table.entries[i].reserved = counter;
+  s_hotp_next[i] = counter;
+  *out_index = i;
+  return true;
+}
+
+// Get the next HOTP counter of an account, a value is never returned twice
+bool storage_hotp_next_counter(const TotpAccount *account, uint64_t *out_counter) {
+  if (!account || !out_counter || account->type != OTP_TYPE_HOTP) return false;
+
+  prv_load_hotp_counters();
+  uint32_t secret_id = prv_secret_id(account);
+  size_t i = 0;
+  while (i < s_hotp_table.count && s_hotp_table.entries[i].secret_id != secret_id) {
+    i++;
+  }
+  if (i == s_hotp_table.count && !prv_add_hotp_counter(secret_id, account->counter, &i)) {
+    return false;
+  }
+
+  // The phone may have been used to generate codes meanwhile, a stale
+  // phone counter never moves it back
+  if (s_hotp_next[i] < account->counter) {
+    s_hotp_next[i] = account->counter;
+  }
+
+  if (s_hotp_next[i] >= s_hotp_table.entries[i].reserved) {
+    uint64_t previous = s_hotp_table.entries[i].reserved;
+    s_hotp_table.entries[i].reserved = s_hotp_next[i] + HOTP_COUNTER_BLOCK;
+    if (!prv_save_hotp_counters()) {
+      s_hotp_table.entries[i].reserved = previous;
+      return false;
+    }
+  }
+
+  *out_counter = s_hotp_next[i]++;
+  return true;
+}
+
+// ============================================================================
+// Usage counters
+// ============================================================================
+//
+// Uses of the most used accounts are counted by uid, so counts survive a
+// resync that reorders or edits the list. Each entry also remembers the ID
+// the account had when last seen, so ordering the list only reads the
+// headers of counted accounts unless the list changed. Counts are written
+// once per USAGE_SAVE_INTERVAL uses and when the app exits.
+
+typedef struct {
+  uint32_t uid;
+  uint16_t count;
+  uint8_t id;  // Hint, checked against the record before it is trusted
+} __attribute__((__packed__)) PersistedUsageCount;
+
+typedef struct {
+  uint8_t count;
+  PersistedUsageCount entries[USAGE_MAX_ENTRIES];
+} __attribute__((__packed__)) UsageCountTable;
+
+static UsageCountTable s_usage_table;
+static bool s_usage_loaded = false;
+static uint8_t s_usage_unsaved = 0;
+
+static void prv_load_usage_counts(void) {
+  if (s_usage_loaded) return;
+  s_usage_loaded = true;
+
+  memset(&s_usage_table, 0, sizeof(s_usage_table));
+  persist_read_data(PERSIST_KEY_USAGE_COUNTS, &s_usage_table, sizeof(s_usage_table));
+  if (s_usage_table.count > USAGE_MAX_ENTRIES) {
+    s_usage_table.count = 0;
+  }
+}
+
+void storage_usage_save(void) {
+  if (s_usage_unsaved == 0) return;
+
+  size_t size = sizeof(s_usage_table.count) + s_usage_table.count * sizeof(PersistedUsageCount);
+  if (persist_write_data(PERSIST_KEY_USAGE_COUNTS, &s_usage_table, size) == (int)size) {
+    s_usage_unsaved = 0;
+  }
+}
+
+void storage_usage_record(size_t id, const TotpAccount *account) {
+  if (!account) return;
+
+  prv_load_usage_counts();
+  uint32_t uid = prv_account_uid(account);
+  size_t i = 0;
+  while (i < s_usage_table.count && s_usage_table.entries[i].uid != uid) {
+    i++;
+  }
+  if (i == s_usage_table.count) {
+    if (s_usage_table.count < USAGE_MAX_ENTRIES) {
+      s_usage_table.count++;
+    } else {
+      // Replace the least used account
+      i = 0;
+      for (size_t j = 1; j < s_usage_table.count; j++) {
+        if (s_usage_table.entries[j].count < s_usage_table.entries[i].count) {
+          i = j;
+        }
+      }
+    }
+    s_usage_table.entries[i].uid = uid;
+    s_usage_table.entries[i].count = 0;
+  }
+
+  if (s_usage_table.entries[i].count == UINT16_MAX) {
+    // Halve all counts so old habits fade out
+    for (size_t j = 0; j < s_usage_table.count; j++) {
+      s_usage_table.entries[j].count /= 2;
+    }
+  }
+  s_usage_table.entries[i].count++;
+  s_usage_table.entries[i].id = id;
+
+  if (++s_usage_unsaved >= USAGE_SAVE_INTERVAL) {
+    storage_usage_save();
+  }
+}
+
+// Point the ID hints at the current list and drop accounts that are gone
+static void prv_remap_usage_counts(void) {
+  size_t count = storage_get_count();
+  bool found[USAGE_MAX_ENTRIES] = { false };
+  for (size_t id = 0; id < count; id++) {
+    AccountInfo info;
+    if (!storage_load_account_info(id, &info)) {
+      // Can't tell which accounts are gone, keep everything
+      return;
+    }
+    for (size_t i = 0; i < s_usage_table.count; i++) {
+      if (s_usage_table.entries[i].uid == info.uid) {
+        s_usage_table.entries[i].id = id;
+        found[i] = true;
+      }
+    }
+  }
+
+  size_t kept = 0;
+  for (size_t i = 0; i < s_usage_table.count; i++) {
+    if (found[i]) {
+      s_usage_table.entries[kept++] = s_usage_table.entries[i];
+    }
+  }
+  s_usage_table.count = kept;
+  s_usage_unsaved++;
+  storage_usage_save();
+}
+
+void storage_usage_get_order(uint8_t *ids, size_t count) {
+  prv_load_usage_counts();
+
+  // Headers are only read for counted accounts, unless the list changed
+  bool stale = false;
+  for (size_t i = 0; i < s_usage_table.count && !stale; i++) {
+    AccountInfo info;
+    stale = s_usage_table.entries[i].id >= count ||
+            !storage_load_account_info(s_usage_table.entries[i].id, &info) ||
+            info.uid != s_usage_table.entries[i].uid;
+  }
+  if (stale) {
+    prv_remap_usage_counts();
+  }
+
+  // Entries sorted by count, at most USAGE_MAX_ENTRIES of them
+  uint8_t order[USAGE_MAX_ENTRIES];
+  for (size_t i = 0; i < s_usage_table.count; i++) {
+    size_t j = i;
+    while (j > 0 && s_usage_table.entries[order[j - 1]].count < s_usage_table.entries[i].count) {
+      order[j] = order[j - 1];
+      j--;
+    }
+    order[j] = i;
+  }
+
+  bool placed[STORAGE_MAX_ACCOUNTS] = { false };
+  size_t row = 0;
+  for (size_t i = 0; i < s_usage_table.count; i++) {
+    uint8_t id = s_usage_table.entries[order[i]].id;
+    if (id < count && !placed[id]) {
+      placed[id] = true;
+      ids[row++] = id;
+    }
+  }
+  for (size_t id = 0; id < count && row < count; id++) {
+    if (!placed[id]) {
+      ids[row++] = id;
+    }
+  }
+}
+
+// ============================================================================
+// Garbage collection
+// ============================================================================
+
+// Delete account records not referenced by the live bank
+size_t storage_collect_garbage(void) {
+#ifdef DEBUG
+  // Fake accounts don't match what is in persist
+  return 0;
+#else
+  // Staged records aren't referenced by any bank yet
+  if (s_staging) return 0;
+
+  prv_load_index();
+  uint8_t live[(STORAGE_MAX_SLOTS + 7) / 8];
+  memset(live, 0, sizeof(live));
+  size_t new_limit = 0;
+  for (size_t i = 0; i < s_active_index.count; i++) {
+    prv_mark_slot_used(live, s_active_index.slots[i]);
+    if ((size_t)s_active_index.slots[i] + 1 > new_limit) {
+      new_limit = s_active_index.slots[i] + 1;
+    }
+  }
+
+  size_t reclaimed = 0;
+  size_t deleted = 0;
+  size_t limit = prv_slot_limit();
+  for (size_t slot = 0; slot < limit; slot++) {
+    uint32_t key = prv_slot_key(slot);
+    if (prv_slot_is_used(live, slot) || !persist_exists(key)) {
+      continue;
+    }
+    int size = persist_get_size(key);
+    if (size > 0) {
+      reclaimed += (size_t)size;
+    }
+    persist_delete(key);
+    deleted++;
+  }
+  prv_set_slot_limit(new_limit);
+
+  // The count lives in the bank index once banks are in use
+  if (s_active_bank != LEGACY_BANK && persist_exists(PERSIST_KEY_COUNT)) {
+    persist_delete(PERSIST_KEY_COUNT);
+  }
+
+  if (deleted > 0) {
+    APP_LOG(APP_LOG_LEVEL_INFO, "Deleted %d stale accounts, %d bytes reclaimed", (int)deleted, (int)reclaimed);
+  }
+  return reclaimed;
+#endif
+}
+
+// ============================================================================
+// Persist accounting
+// ============================================================================
+
+static size_t prv_key_size(uint32_t key) {
+  int size = persist_get_size(key);
+  return size > 0 ? (size_t)size : 0;
+}
+
+// Persist usage by region
+void storage_get_usage(StorageUsage *usage) {
+  if (!usage) return;
+  memset(usage, 0, sizeof(*usage));
+
+  prv_load_index();
+  uint8_t live[(STORAGE_MAX_SLOTS + 7) / 8];
+  memset(live, 0, sizeof(live));
+  for (size_t i = 0; i < s_active_index.count; i++) {
+    prv_mark_slot_used(live, s_active_index.slots[i]);
+  }
+
+  size_t limit = prv_slot_limit();
+  for (size_t slot = 0; slot < limit; slot++) {
+    size_t size = prv_key_size(prv_slot_key(slot));
+    if (prv_slot_is_used(live, slot)) {
+      usage->accounts += size;
+    } else {
+      usage->stale += size;
+    }
+  }
+
+  usage->index = prv_key_size(PERSIST_KEY_COUNT) +
+                 prv_key_size(PERSIST_KEY_ACTIVE_BANK) +
+                 prv_key_size(PERSIST_KEY_BANK_INDEX_0) +
+                 prv_key_size(PERSIST_KEY_BANK_INDEX_1) +
+                 prv_key_size(PERSIST_KEY_SLOT_LIMIT);
+  usage->counters = prv_key_size(PERSIST_KEY_HOTP_COUNTERS) + prv_key_size(PERSIST_KEY_HOTP_COUNTERS_BY_UID) +
+                    prv_key_size(PERSIST_KEY_USAGE_COUNTS);
+  usage->pin = prv_key_size(PERSIST_KEY_PIN_HASH);
+  usage->settings = prv_key_size(PERSIST_KEY_STATUSBAR_ENABLED) + prv_key_size(PERSIST_KEY_LOW_POWER_REFRESH) +
+                    prv_key_size(PERSIST_KEY_MOST_USED_FIRST) + prv_key_size(PERSIST_KEY_PINNED_ACCOUNT) +
+                    prv_key_size(PERSIST_KEY_IDLE_SECONDS) + prv_key_size(PERSIST_KEY_EXIT_SECONDS) +
+                    prv_key_size(PERSIST_KEY_HEAP_RESERVE);
+
+  usage->used = usage->accounts + usage->stale + usage->index + usage->counters + usage->pin + usage->settings;
+  usage->free = usage->used < PERSIST_QUOTA ? PERSIST_QUOTA - usage->used : 0;
+}
+
+// Stored size of an account record with the given type, string and secret lengths
+size_t storage_record_size(OtpType type, size_t label_len, size_t account_name_len, size_t secret_len) {
+  if (label_len > LABEL_MAX_LEN) label_len = LABEL_MAX_LEN;
+  if (account_name_len > ACCOUNT_NAME_MAX_LEN) account_name_len = ACCOUNT_NAME_MAX_LEN;
+  if (secret_len > SECRET_BYTES_MAX) secret_len = SECRET_BYTES_MAX;
+  return prv_layout_size(type, label_len, account_name_len, secret_len);
+}
+
+// Size of the largest possible account record
+size_t storage_max_record_size(void) {
+  return storage_record_size(OTP_TYPE_HOTP, LABEL_MAX_LEN, ACCOUNT_NAME_MAX_LEN, SECRET_BYTES_MAX);
+}
+
+// How many more accounts of the given shape would fit into the free space
+size_t storage_accounts_that_fit(OtpType type, size_t label_len, size_t account_name_len, size_t secret_len) {
+  StorageUsage usage;
+  storage_get_usage(&usage);
+
+  // Stale records go away with the next garbage collection
+  size_t available = usage.free + usage.stale;
+  size_t per_account = storage_record_size(type, label_len, account_name_len, secret_len) + 1;  // + index entry
+  size_t fit = available / per_account;
+
+  size_t count = storage_get_count();
+  size_t room = count < STORAGE_MAX_ACCOUNTS ? STORAGE_MAX_ACCOUNTS - count : 0;
+  return fit < room ? fit : room;
+}
+
+// Whether a list of count accounts with payload_size bytes of strings, secrets and HOTP counters fits
+bool storage_list_fits(size_t count, size_t payload_size) {
+  if (count > STORAGE_MAX_ACCOUNTS) {
+    return false;
+  }
+
+  StorageUsage usage;
+  storage_get_usage(&usage);
+
+  // Unchanged records reuse their live slots, which ones is only known once
+  // they arrive. Only lists that can't be stored even in place of the live
+  // one are rejected here, storage_sync_save_account checks every record
+  // that needs a new slot against the space left next to the live list.
+  size_t fixed = usage.pin + usage.settings + usage.index + usage.counters;
+  size_t needed = count * prv_layout_size(OTP_TYPE_TOTP, 0, 0, 0) + payload_size + sizeof(uint8_t) + count;
+  return fixed + needed <= PERSIST_QUOTA;
 }
 
 // ============================================================================
@@ -226,3 +1269,138 @@ void storage_set_statusbar_enabled(bool enabled) {
   persist_write_bool(PERSIST_KEY_STATUSBAR_ENABLED, enabled);
 }
 
+// ============================================================================
+// Refresh mode management
+// ============================================================================
+
+bool storage_is_low_power_refresh_enabled(void) {
+  if (!persist_exists(PERSIST_KEY_LOW_POWER_REFRESH)) {
+    return false;  // Default: refresh every second
+  }
+  return (bool)persist_read_bool(PERSIST_KEY_LOW_POWER_REFRESH);
+}
+
+void storage_set_low_power_refresh_enabled(bool enabled) {
+  persist_write_bool(PERSIST_KEY_LOW_POWER_REFRESH, enabled);
+}
+
+// ============================================================================
+// List order management
+// ============================================================================
+
+bool storage_is_most_used_first_enabled(void) {
+  if (!persist_exists(PERSIST_KEY_MOST_USED_FIRST)) {
+    return false;  // Default: order from the phone
+  }
+  return (bool)persist_read_bool(PERSIST_KEY_MOST_USED_FIRST);
+}
+
+void storage_set_most_used_first_enabled(bool enabled) {
+  persist_write_bool(PERSIST_KEY_MOST_USED_FIRST, enabled);
+}
+
+// ============================================================================
+// Idle policy management
+// ============================================================================
+
+uint16_t storage_get_idle_seconds(void) {
+  if (!persist_exists(PERSIST_KEY_IDLE_SECONDS)) {
+    return DEFAULT_IDLE_SECONDS;
+  }
+  return (uint16_t)persist_read_int(PERSIST_KEY_IDLE_SECONDS);
+}
+
+void storage_set_idle_seconds(uint16_t seconds) {
+  persist_write_int(PERSIST_KEY_IDLE_SECONDS, seconds);
+}
+
+uint16_t storage_get_exit_seconds(void) {
+  if (!persist_exists(PERSIST_KEY_EXIT_SECONDS)) {
+    return DEFAULT_EXIT_SECONDS;
+  }
+  return (uint16_t)persist_read_int(PERSIST_KEY_EXIT_SECONDS);
+}
+
+void storage_set_exit_seconds(uint16_t seconds) {
+  persist_write_int(PERSIST_KEY_EXIT_SECONDS, seconds);
+}
+
+uint16_t storage_get_heap_reserve(void) {
+  if (!persist_exists(PERSIST_KEY_HEAP_RESERVE)) {
+    return 0;
+  }
+  return (uint16_t)persist_read_int(PERSIST_KEY_HEAP_RESERVE);
+}
+
+void storage_set_heap_reserve(uint16_t bytes) {
+  persist_write_int(PERSIST_KEY_HEAP_RESERVE, bytes);
+}
+
+// ============================================================================
+// Pinned account management
+// ============================================================================
+//
+// The pinned account is kept by uid with the ID it had when pinned, so
+// showing it on launch usually takes a single record read.
+
+typedef struct {
+  uint32_t uid;
+  uint8_t id;  // Hint, checked against the record before it is trusted
+} __attribute__((__packed__)) PersistedPinnedAccount;
+
+static bool prv_read_pinned(PersistedPinnedAccount *pinned) {
+  return persist_read_data(PERSIST_KEY_PINNED_ACCOUNT, pinned, sizeof(*pinned)) == sizeof(*pinned);
+}
+
+bool storage_has_pinned_account(void) {
+  return persist_exists(PERSIST_KEY_PINNED_ACCOUNT);
+}
+
+bool storage_is_pinned_account(const TotpAccount *account) {
+  PersistedPinnedAccount pinned;
+  return account && prv_read_pinned(&pinned) && pinned.uid == prv_account_uid(account);
+}
+
+bool storage_is_pinned_account_id(size_t id) {
+  PersistedPinnedAccount pinned;
+  AccountInfo info;
+  return prv_read_pinned(&pinned) && storage_load_account_info(id, &info) && info.uid == pinned.uid;
+}
+
+void storage_set_pinned_account(size_t id, const TotpAccount *account) {
+  if (!account) return;
+
+  PersistedPinnedAccount pinned = {
+    .uid = prv_account_uid(account),
+    .id = id,
+  };
+  persist_write_data(PERSIST_KEY_PINNED_ACCOUNT, &pinned, sizeof(pinned));
+}
+
+void storage_clear_pinned_account(void) {
+  persist_delete(PERSIST_KEY_PINNED_ACCOUNT);
+}
+
+bool storage_load_pinned_account(TotpAccount *account) {
+  PersistedPinnedAccount pinned;
+  if (!account || !prv_read_pinned(&pinned)) return false;
+
+  if (storage_load_account(pinned.id, account) && prv_account_uid(account) == pinned.uid) {
+    return true;
+  }
+
+  // The list changed since the account was pinned, find it by uid
+  size_t count = storage_get_count();
+  for (size_t id = 0; id < count; id++) {
+    AccountInfo info;
+    if (storage_load_account_info(id, &info) && info.uid == pinned.uid &&
+        storage_load_account(id, account)) {
+      storage_set_pinned_account(id, account);
+      return true;
+    }
+  }
+  
+  // Removed from the list, don't look for it on every launch
+  storage_clear_pinned_account();
+  return false;
+}
@@ -2,29 +2,121 @@
 
 #include "totp.h"
 
-#define PERSIST_KEY_COUNT 0
+#define PERSIST_KEY_COUNT 0  // Legacy, replaced by the bank index
 #define PERSIST_KEY_PIN_HASH 2
 #define PERSIST_KEY_STATUSBAR_ENABLED 3
-#define PERSIST_KEY_ACCOUNTS_START 8
+#define PERSIST_KEY_ACTIVE_BANK 4
+#define PERSIST_KEY_BANK_INDEX_0 5
+#define PERSIST_KEY_BANK_INDEX_1 6
+#define PERSIST_KEY_SLOT_LIMIT 7
+#define PERSIST_KEY_ACCOUNTS_START 8  // Account slots, up to STORAGE_MAX_SLOTS keys
+#define PERSIST_KEY_HOTP_COUNTERS_BY_UID 256  // Legacy, past the account slots
+#define PERSIST_KEY_LOW_POWER_REFRESH 257
+#define PERSIST_KEY_USAGE_COUNTS 258
+#define PERSIST_KEY_MOST_USED_FIRST 259
+#define PERSIST_KEY_PINNED_ACCOUNT 260
+#define PERSIST_KEY_IDLE_SECONDS 261
+#define PERSIST_KEY_EXIT_SECONDS 262
+#define PERSIST_KEY_HEAP_RESERVE 263
+#define PERSIST_KEY_HOTP_COUNTERS 264
+
+// Same limit as the phone configuration page
+#define STORAGE_MAX_ACCOUNTS 100
+// Enough for two full lists with nothing in common
+#define STORAGE_MAX_SLOTS (STORAGE_MAX_ACCOUNTS * 2)
+
+// HOTP accounts with a counter kept on the watch
+#define HOTP_MAX_COUNTERS 16
+// HOTP counter values reserved by a single persist write
+#define HOTP_COUNTER_BLOCK 16
+
+// Accounts with a usage count, the table has to fit into one persist value
+#define USAGE_MAX_ENTRIES 36
+// Uses counted in RAM before the table is written
+#define USAGE_SAVE_INTERVAL 16
+
+// What the account list needs to know about an account without loading it
+typedef struct {
+  uint32_t uid;
+  uint32_t period;
+  uint8_t digits;
+  uint8_t algorithm;  // TotpAlgorithm
+  uint8_t type;       // OtpType
+  bool has_account_name;
+  char initial;       // See storage_label_initial
+} AccountInfo;
+
+typedef struct {
+  size_t accounts;  // Records of the current list
+  size_t stale;     // Records waiting for garbage collection
+  size_t index;     // Bank indexes and bookkeeping
+  size_t counters;  // HOTP and usage counters
+  size_t pin;
+  size_t settings;
+  size_t used;      // Sum of all of the above
+  size_t free;      // Left of PERSIST_QUOTA
+} StorageUsage;
 
 // Get account count
 size_t storage_get_count(void);
 
-// Set account count
-void storage_set_count(size_t count);
-
 // Load account by ID
 bool storage_load_account(size_t id, TotpAccount *account);
 
-// Save account by ID
-bool storage_save_account(size_t id, const TotpAccount *account);
+// Load account metadata by ID, reads only the record header
+bool storage_load_account_info(size_t id, AccountInfo *info);
 
-// Delete account by ID
-void storage_delete_account(size_t id);
+// Upper-cased first letter of a label, '#' if it doesn't start with a letter
+char storage_label_initial(const char *label);
 
 // Load account count from storage
 void storage_load_accounts(void);
 
+// Start staging a new account list, the current one stays readable meanwhile
+bool storage_sync_begin(size_t count);
+
+// Stage account by ID for the list being synced, fails if it needs a new
+// slot and doesn't fit next to the current list
+bool storage_sync_save_account(size_t id, const TotpAccount *account);
+
+// Atomically switch to the staged list, fails if some accounts are missing
+bool storage_sync_commit(void);
+
+// Drop the staged list
+void storage_sync_abort(void);
+
+// Delete account records not used by the current list, returns reclaimed bytes
+size_t storage_collect_garbage(void);
+
+// Get the next HOTP counter of an account, a value is never returned twice
+bool storage_hotp_next_counter(const TotpAccount *account, uint64_t *out_counter);
+
+// Persist usage by region
+void storage_get_usage(StorageUsage *usage);
+
+// Count a use of the account with the given ID
+void storage_usage_record(size_t id, const TotpAccount *account);
+
+// Fill ids with all account IDs, most used first and the rest in list order
+void storage_usage_get_order(uint8_t *ids, size_t count);
+
+// Write usage counts that are only in RAM
+void storage_usage_save(void);
+
+// Stored size of an account record with the given type, string and secret
+// lengths, HOTP records also hold the initial counter
+size_t storage_record_size(OtpType type, size_t label_len, size_t account_name_len, size_t secret_len);
+
+// Size of the largest possible account record
+size_t storage_max_record_size(void);
+
+// How many more accounts of the given shape would fit into the free space
+size_t storage_accounts_that_fit(OtpType type, size_t label_len, size_t account_name_len, size_t secret_len);
+
+// Whether a list of count accounts with payload_size bytes of strings, secrets and HOTP counters
+// could be stored at all, records needing a new slot are checked again while staging
+bool storage_list_fits(size_t count, size_t payload_size);
+
 // PIN management
 bool storage_has_pin(void);
 uint32_t storage_get_pin_hash(void);
@@ -36,3 +128,32 @@ void storage_clear_pin(void);
 bool storage_is_statusbar_enabled(void);
 void storage_set_statusbar_enabled(bool enabled);
 
+// Refresh mode management
+bool storage_is_low_power_refresh_enabled(void);
+void storage_set_low_power_refresh_enabled(bool enabled);
+
+// List order management
+bool storage_is_most_used_first_enabled(void);
+void storage_set_most_used_first_enabled(bool enabled);
+
+// Idle policy management, timeouts in seconds, 0 for never
+uint16_t storage_get_idle_seconds(void);
+void storage_set_idle_seconds(uint16_t seconds);
+uint16_t storage_get_exit_seconds(void);
+void storage_set_exit_seconds(uint16_t seconds);
+
+// Measured heap reserve in bytes, 0 until one was stored
+uint16_t storage_get_heap_reserve(void);
+void storage_set_heap_reserve(uint16_t bytes);
+
+// Pinned account management, the pinned account is shown on launch
+bool storage_has_pinned_account(void);
+bool storage_is_pinned_account(const TotpAccount *account);
+// Same check from the record header, without loading the account
+bool storage_is_pinned_account_id(size_t id);
+void storage_set_pinned_account(size_t id, const TotpAccount *account);
+void storage_clear_pinned_account(void);
+
+// Load the pinned account, false if none is pinned or it was removed
+bool storage_load_pinned_account(TotpAccount *account);
+
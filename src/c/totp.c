@@ -1,4 +1,7 @@
 #include "totp.h"
+#include "profile.h"
+#include "diagnostics.h"
+#include "trace.h"
 #include <stdlib.h>
 #include <string.h>
 #include <stdbool.h>
@@ -616,27 +619,26 @@ void prv_hmac_sha512(const uint8_t *key, size_t key_len, const uint8_t *data, si
 }
 
 // ============================================================================
-// TOTP Generation
+// TOTP/HOTP Generation
 // ============================================================================
 
-bool totp_generate(const TotpAccount *account, time_t now, char *output, size_t output_len, uint64_t *out_counter) {
+static bool prv_generate_code(const TotpAccount *account, uint64_t counter, char *output, size_t output_len) {
   if (!account || account->secret_len == 0 || !output || output_len == 0) {
     return false;
   }
-  uint32_t period = account->period > 0 ? account->period : DEFAULT_PERIOD;
   uint8_t digits = account->digits >= MIN_DIGITS && account->digits <= MAX_DIGITS ? account->digits : DEFAULT_DIGITS;
+  diagnostics_count_code();
 
-  uint64_t counter = (uint64_t)(now / period);
   uint8_t message[8];
   for (int i = 7; i >= 0; i--) {
     message[i] = (uint8_t)(counter & 0xFF);
     counter >>= 8;
   }
-  counter = (uint64_t)(now / period);
 
   // Select hash algorithm
   uint8_t hash[64];  // Max size for SHA512
   size_t hash_len;
+  TRACE_BEGIN(TRACE_HMAC, account->algorithm);
   
   switch (account->algorithm) {
     case TOTP_ALGO_SHA256:
@@ -655,6 +657,7 @@ bool totp_generate(const TotpAccount *account, time_t now, char *output, size_t
       hash_len = 20;
       break;
   }
+  TRACE_END(TRACE_HMAC, account->algorithm);
 
   uint8_t offset = hash[hash_len - 1] & 0x0F;
   uint32_t binary =
@@ -672,9 +675,29 @@ bool totp_generate(const TotpAccount *account, time_t now, char *output, size_t
     return false;
   }
   snprintf(output, output_len, "%0*u", digits, (unsigned int)otp);
+  return true;
+}
+
+bool totp_generate(const TotpAccount *account, time_t now, char *output, size_t output_len, uint64_t *out_counter) {
+  if (!account) {
+    return false;
+  }
+  uint32_t period = account->period > 0 ? account->period : DEFAULT_PERIOD;
+  uint64_t counter = (uint64_t)(now / period);
+
+  PROFILE_START(start);
+  bool generated = prv_generate_code(account, counter, output, output_len);
+  PROFILE_STOP(PROFILE_TOTP_SHA1 + (account->algorithm <= TOTP_ALGO_SHA512 ? account->algorithm : TOTP_ALGO_SHA1), start);
+  if (!generated) {
+    return false;
+  }
 
   if (out_counter) {
     *out_counter = counter;
   }
   return true;
 }
+
+bool hotp_generate(const TotpAccount *account, uint64_t counter, char *output, size_t output_len) {
+  return prv_generate_code(account, counter, output, output_len);
+}
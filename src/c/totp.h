@@ -19,6 +19,11 @@ typedef enum {
   TOTP_ALGO_SHA512 = 2
 } TotpAlgorithm;
 
+typedef enum {
+  OTP_TYPE_TOTP = 0,
+  OTP_TYPE_HOTP = 1
+} OtpType;
+
 typedef struct {
   char label[LABEL_MAX_LEN + 1];
   char account_name[ACCOUNT_NAME_MAX_LEN + 1];
@@ -27,11 +32,16 @@ typedef struct {
   uint32_t period;
   uint8_t digits;
   uint8_t algorithm;  // TotpAlgorithm
+  uint8_t type;       // OtpType
+  uint64_t counter;   // HOTP counter as sent by the phone
 } TotpAccount;
 
 // Generate TOTP code
 bool totp_generate(const TotpAccount *account, time_t now, char *output, size_t output_len, uint64_t *out_counter);
 
+// Generate HOTP code for the given counter
+bool hotp_generate(const TotpAccount *account, uint64_t counter, char *output, size_t output_len);
+
 // Decode base32 secret
 int base32_decode(const char *input, uint8_t *output, size_t output_max);
 
@@ -4,25 +4,150 @@
 #include "comms.h"
 #include "config.h"
 #include "pin_window.h"
+#include "code_window.h"
+#include "profile.h"
+#include "trace.h"
+#include "memory.h"
+#include "activity.h"
 
 // === Global variables =======================================================
 
 static PinWindow *s_pin_window = NULL;
+static CodeWindow *s_code_window = NULL;
 static bool s_pin_verified = false;
 static int s_pin_attempts = 0;
+static AppTimer *s_preload_timer = NULL;
+static bool s_accounts_loaded = false;
+static bool s_comms_started = false;
+static bool s_garbage_collected = false;
+
+// === Launch pipeline ========================================================
+//
+// The PIN window is shown before anything is loaded. Accounts, the first
+// codes and AppMessage are prepared in the background while the PIN is
+// entered, so the list shows filled in codes as soon as it opens.
+
+static void prv_load_accounts(void) {
+  if (s_accounts_loaded) return;
+  
+  // Load account count, drop records orphaned by an earlier shorter sync
+  storage_load_accounts();
+  if (!s_garbage_collected) {
+    storage_collect_garbage();
+    s_garbage_collected = true;
+  }
+  ui_set_total_count(s_total_account_count);
+  s_accounts_loaded = true;
+}
+
+static void prv_start_comms(void) {
+  if (!s_comms_started) {
+    comms_init();
+    s_comms_started = true;
+  }
+}
+
+static void prv_preload(void *data) {
+  s_preload_timer = NULL;
+  // The list isn't needed unless the user backs out of the pinned account,
+  // a sync has to get through either way
+  if (!storage_has_pinned_account()) {
+    prv_load_accounts();
+  }
+  prv_start_comms();
+}
+
+static void prv_schedule_preload(void) {
+  if (!s_preload_timer) {
+    s_preload_timer = app_timer_register(0, prv_preload, NULL);
+  }
+}
+
+static void prv_cancel_preload(void) {
+  if (s_preload_timer) {
+    app_timer_cancel(s_preload_timer);
+    s_preload_timer = NULL;
+  }
+}
+
+// Drop codes and secrets loaded for an attempt that turned out to be wrong
+static void prv_discard_accounts(void) {
+  prv_cancel_preload();
+  if (s_accounts_loaded) {
+    ui_discard_accounts();
+    s_accounts_loaded = false;
+  }
+}
+
+// === Opening ================================================================
+//
+// A pinned account is shown on its own first. It takes a single record read
+// and one code, the list is only loaded if the user backs out of it.
+
+static void prv_open_list(void) {
+  // Finish whatever the background didn't get to
+  prv_cancel_preload();
+  prv_load_accounts();
+  prv_start_comms();
+  ui_init();
+}
+
+static void prv_code_window_back(void *context) {
+  prv_open_list();
+  code_window_remove(s_code_window, false);
+}
+
+static void prv_destroy_code_window(void *data) {
+  code_window_destroy(s_code_window);
+  s_code_window = NULL;
+}
+
+// The window can't be destroyed from its own unload, the timer wipes the
+// account copy as soon as the unload is over
+static void prv_code_window_unload(void *context) {
+  app_timer_register(0, prv_destroy_code_window, NULL);
+}
+
+static bool prv_open_pinned(void) {
+  TotpAccount account;
+  if (!storage_load_pinned_account(&account) || account.type != OTP_TYPE_TOTP) {
+    return false;
+  }
+  
+  s_code_window = code_window_create(&account, (CodeWindowCallbacks){
+    .back = prv_code_window_back,
+    .unload = prv_code_window_unload,
+  }, NULL);
+  memset(&account, 0, sizeof(account));
+  if (!s_code_window) return false;
+  
+  code_window_push(s_code_window, true);
+  prv_schedule_preload();  // Opens AppMessage after the first frame
+  return true;
+}
+
+// The startup phase covers the preloads and PIN attempts before this too
+static void prv_open(void) {
+  if (!prv_open_pinned()) {
+    prv_open_list();
+  }
+  memory_phase_end(MEMORY_PHASE_STARTUP);
+}
 
 // === PIN window callbacks ===================================================
 
 static void prv_pin_complete_handler(Pin pin, void *context) {
   if (storage_verify_pin(pin.digits[0], pin.digits[1], pin.digits[2])) {
     s_pin_verified = true;
-    ui_init();
+    ui_set_locked(false);
+    
+    prv_open();
     pin_window_pop(s_pin_window, true);
-    comms_init();
     
     APP_LOG(APP_LOG_LEVEL_INFO, "PIN verified successfully");
   } else {
     s_pin_attempts++;
+    prv_discard_accounts();
     
     // Reset PIN input
     pin_window_reset(s_pin_window);
@@ -41,6 +166,9 @@ static void prv_pin_complete_handler(Pin pin, void *context) {
       
       // Schedule app exit after a short delay
       app_timer_register(2000, (AppTimerCallback)window_stack_pop_all, NULL);
+    } else {
+      // Prepare again for the next attempt
+      prv_schedule_preload();
     }
   }
 }
@@ -54,15 +182,16 @@ static void prv_init(void) {
   APP_LOG(APP_LOG_LEVEL_WARNING, "Using fake TOTP accounts for testing");
   APP_LOG(APP_LOG_LEVEL_WARNING, "========================================");
 #endif
+  profile_init();
+  trace_init();
+  memory_phase_begin(MEMORY_PHASE_STARTUP);
+  activity_init();  // The PIN window times out too
   
-  // Load account count
-  storage_load_accounts();
-  ui_set_total_count(s_total_account_count);
- 
   // Check if PIN is enabled
   if (storage_has_pin()) {
     s_pin_verified = false;
     s_pin_attempts = 0;
+    ui_set_locked(true);
     
     // Create and show PIN window
     s_pin_window = pin_window_create((PinWindowCallbacks){
@@ -72,21 +201,32 @@ static void prv_init(void) {
     if (s_pin_window) {
       pin_window_push(s_pin_window, true);
     }
+    prv_schedule_preload();
   } else {
     s_pin_verified = true;  // No PIN required
-    ui_init();
-    comms_init();
+    prv_open();
   }
 }
 
 static void prv_deinit(void) {
+  prv_cancel_preload();
+  
   if (s_pin_window) {
     pin_window_destroy(s_pin_window);
     s_pin_window = NULL;
   }
   
+  if (s_code_window) {
+    code_window_destroy(s_code_window);
+    s_code_window = NULL;
+  }
+  
   comms_deinit();
   ui_deinit();
+  activity_deinit();
+  storage_usage_save();
+  memory_save();
+  profile_deinit();
 }
 
 int main(void) {
@@ -0,0 +1,53 @@
+#include "trace.h"
+
+#ifdef TRACE
+
+static TraceRecord s_records[TRACE_CAPACITY];
+static size_t s_next = 0;  // Slot written next
+static size_t s_count = 0;
+static bool s_frozen = false;
+static time_t s_start_seconds = 0;
+static uint16_t s_start_ms = 0;
+
+void trace_init(void) {
+  time_ms(&s_start_seconds, &s_start_ms);
+  s_next = 0;
+  s_count = 0;
+  s_frozen = false;
+}
+
+void trace_record(TraceEvent event, TracePhase phase, uint16_t arg) {
+  if (s_frozen) return;
+
+  time_t seconds;
+  uint16_t ms;
+  time_ms(&seconds, &ms);
+
+  TraceRecord *record = &s_records[s_next];
+  record->time_ms = (uint32_t)(seconds - s_start_seconds) * 1000 + ms - s_start_ms;
+  record->event = event;
+  record->phase = phase;
+  record->arg = arg;
+
+  s_next = (s_next + 1) % TRACE_CAPACITY;
+  if (s_count < TRACE_CAPACITY) s_count++;
+}
+
+void trace_freeze(bool frozen) {
+  s_frozen = frozen;
+}
+
+size_t trace_get_count(void) {
+  return s_count;
+}
+
+size_t trace_read(size_t index, TraceRecord *out, size_t max) {
+  size_t oldest = (s_next + TRACE_CAPACITY - s_count) % TRACE_CAPACITY;
+  size_t copied = 0;
+  for (; copied < max && index + copied < s_count; copied++) {
+    out[copied] = s_records[(oldest + index + copied) % TRACE_CAPACITY];
+  }
+  return copied;
+}
+
+#endif
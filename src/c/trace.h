@@ -0,0 +1,62 @@
+#pragma once
+
+#include <pebble.h>
+#include "config.h"
+
+// Timestamped events kept in a RAM ring buffer, only compiled in with TRACE
+// defined in config.h. The buffer is sent to the phone on request, see
+// comms_send_trace() and tools/trace_to_chrome.py.
+
+typedef enum {
+  TRACE_TICK,           // ui_update_codes
+  TRACE_HMAC,           // arg: TotpAlgorithm
+  TRACE_PERSIST_READ,   // arg: persist key
+  TRACE_PERSIST_WRITE,  // arg: persist key
+  TRACE_MESSAGE_IN,
+  TRACE_MESSAGE_OUT,    // arg: message key
+  TRACE_EVENT_COUNT
+} TraceEvent;
+
+typedef enum {
+  TRACE_PHASE_BEGIN,
+  TRACE_PHASE_END,
+  TRACE_PHASE_INSTANT
+} TracePhase;
+
+// One event, as kept and as sent (little endian)
+typedef struct {
+  uint32_t time_ms;  // Since trace_init
+  uint8_t event;     // TraceEvent
+  uint8_t phase;     // TracePhase
+  uint16_t arg;
+} __attribute__((__packed__)) TraceRecord;
+
+#ifdef TRACE
+
+// Events kept, older ones are overwritten
+#define TRACE_CAPACITY 256
+
+void trace_init(void);
+void trace_record(TraceEvent event, TracePhase phase, uint16_t arg);
+
+// Stop recording while the buffer is being sent
+void trace_freeze(bool frozen);
+
+// Events in the buffer
+size_t trace_get_count(void);
+
+// Copy up to max events starting at index, oldest first, returns the number copied
+size_t trace_read(size_t index, TraceRecord *out, size_t max);
+
+#define TRACE_BEGIN(event, arg) trace_record(event, TRACE_PHASE_BEGIN, arg)
+#define TRACE_END(event, arg) trace_record(event, TRACE_PHASE_END, arg)
+#define TRACE_INSTANT(event, arg) trace_record(event, TRACE_PHASE_INSTANT, arg)
+
+#else
+
+#define trace_init()
+#define TRACE_BEGIN(event, arg)
+#define TRACE_END(event, arg)
+#define TRACE_INSTANT(event, arg)
+
+#endif
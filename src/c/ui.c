@@ -2,117 +2,477 @@
 #include "totp.h"
 #include "storage.h"
 #include "settings_window.h"
+#include "slab.h"
+#include "code_renderer.h"
+#include "profile.h"
+#include "diagnostics.h"
+#include "trace.h"
+#include "memory.h"
 #include "config.h"
+#include "activity.h"
 #include <string.h>
 
 // Forward declarations
-static void prv_menu_select_callback(MenuLayer *menu_layer, MenuIndex *cell_index, void *data);
+static void prv_list_select_callback(uint16_t row, void *context);
+static void prv_list_select_long_callback(uint16_t row, void *context);
+static void prv_list_selection_changed_callback(uint16_t new_row, uint16_t old_row, void *context);
+static uint16_t prv_list_get_jump_row_callback(uint16_t row, int direction, void *context);
 
 // UI global variables
 Window *s_window;
-MenuLayer *s_menu_layer;
+AccountListLayer *s_list_layer;
+static Layer *s_progress_layer;
 TextLayer *s_empty_layer;
 StatusBarLayer *s_status_bar;
 size_t s_total_account_count;
-AccountCache *s_account_cache;
+AccountCache s_account_cache;
 static bool s_is_loading = false;
 static bool s_out_of_memory = false;
+static bool s_headers_only = false;  // No room for accounts, rows show header metadata
+static bool s_storage_full = false;
+static GFont s_label_font;
+static GFont s_account_name_font;
+static GFont s_code_font;  // Fallback for codes the digit atlas can't draw
 static SettingsWindow *s_settings_window = NULL;
+static AppTimer *s_refresh_timer = NULL;
+static bool s_low_power_refresh = false;
+static bool s_locked = false;  // The PIN hasn't been entered yet
+static bool s_sync_pending = false;  // A sync committed while locked
 
 // ============================================================================
 // Account loading and caching
 // ============================================================================
+//
+// Every row has a small AccountCache entry with metadata read from the
+// record header, its code and time remaining. Full accounts (secrets and
+// strings) are only kept for up to ACCOUNT_POOL_SIZE rows around the
+// visible ones and are loaded from storage as the list scrolls, least
+// recently used ones are dropped first. Resident accounts live in one
+// slab sized once per list, so scrolling never allocates from the heap.
 
-static void prv_load_account(size_t index) {
-  if (index >= s_total_account_count) return;
-  
-  AccountCache *cache = &s_account_cache[index];
-  if (cache->account) return;
-  
-  cache->account = malloc(sizeof(TotpAccount));
-  if (!cache->account) {
-    s_out_of_memory = true;
+#define ELLIPSIS "\xe2\x80\xa6"
+
+// A resident account with its label and account name already truncated to
+// the row width, so drawing a row doesn't lay out ellipses every frame
+typedef struct {
+  TotpAccount account;  // First, so account pointers are block pointers
+  int16_t render_width;  // Text width the strings were fitted to, 0 if not yet
+  char label[LABEL_MAX_LEN + sizeof(ELLIPSIS)];
+  char account_name[ACCOUNT_NAME_MAX_LEN + sizeof(ELLIPSIS)];
+} ResidentAccount;
+
+// Most rows on screen at once, counting partly visible ones at both ends.
+// The shortest row is a label, a code and the countdown line.
+#define ROW_MIN_HEIGHT (15 + 35 + 1)
+#define VISIBLE_ROWS_MAX (PBL_DISPLAY_HEIGHT / ROW_MIN_HEIGHT + 2)
+
+static Slab *s_account_slab = NULL;
+static int16_t s_resident_rows[ACCOUNT_POOL_SIZE];  // Rows holding a slab block
+static uint8_t s_resident_count = 0;
+static uint32_t s_lru_clock = 0;
+static int8_t s_scroll_direction = 1;  // 1 when the selection last moved down, -1 when up
+
+// Rows with the same period change codes at the same time, so the time step
+// and remaining seconds are computed once per period per refresh
+#define MAX_PERIOD_COHORTS 8
+#define NO_COHORT 0xFF  // Row computes its own time math when all cohorts are taken
+
+typedef struct {
+  uint16_t period;
+  uint16_t remaining;
+  uint64_t step;
+} PeriodCohort;
+
+static PeriodCohort s_cohorts[MAX_PERIOD_COHORTS];
+static uint8_t s_cohort_count = 0;
+static time_t s_cohorts_updated = 0;
+
+static void prv_generate_code(size_t index, time_t now) {
+  TotpAccount *account = s_account_cache.accounts[index];
+  if (!account || account->type != OTP_TYPE_TOTP) return;
+
+  char *code = s_account_cache.codes[index];
+  if (!totp_generate(account, now, code, sizeof(s_account_cache.codes[index]), &s_account_cache.code_counters[index])) {
+    snprintf(code, sizeof(s_account_cache.codes[index]), "ERROR");
+    s_account_cache.flags[index] &= ~ACCOUNT_CODE_VALID;
+  } else {
+    s_account_cache.flags[index] |= ACCOUNT_CODE_VALID;
+  }
+}
+
+static uint8_t prv_get_cohort(uint16_t period) {
+  for (uint8_t i = 0; i < s_cohort_count; i++) {
+    if (s_cohorts[i].period == period) {
+      return i;
+    }
+  }
+  if (s_cohort_count == MAX_PERIOD_COHORTS) {
+    return NO_COHORT;
+  }
+  s_cohorts[s_cohort_count] = (PeriodCohort){ .period = period };
+  s_cohorts_updated = 0;
+  return s_cohort_count++;
+}
+
+static void prv_update_cohorts(time_t now) {
+  if (now == s_cohorts_updated) return;
+
+  for (uint8_t i = 0; i < s_cohort_count; i++) {
+    s_cohorts[i].step = now / s_cohorts[i].period;
+    s_cohorts[i].remaining = s_cohorts[i].period - (uint16_t)(now % s_cohorts[i].period);
+  }
+  s_cohorts_updated = now;
+}
+
+// Bring a TOTP row's time remaining and code up to date, true if its code changed
+static bool prv_refresh_code(size_t index, time_t now) {
+  // HOTP codes only change on request
+  if (!(s_account_cache.flags[index] & ACCOUNT_INFO_VALID) || s_account_cache.types[index] != OTP_TYPE_TOTP) {
+    return false;
+  }
+
+  uint8_t cohort = s_account_cache.cohorts[index];
+  uint64_t step;
+  if (cohort != NO_COHORT) {
+    prv_update_cohorts(now);
+    step = s_cohorts[cohort].step;
+    s_account_cache.remaining[index] = s_cohorts[cohort].remaining;
+  } else {
+    uint32_t period = s_account_cache.periods[index];
+    step = now / period;
+    s_account_cache.remaining[index] = period - (uint32_t)(now % period);
+  }
+  if (s_account_cache.code_counters[index] == step) {
+    return false;
+  }
+
+  // New time step: regenerate if the account is loaded, otherwise
+  // the code is regenerated when the row is loaded again
+  if (s_account_cache.accounts[index]) {
+    prv_generate_code(index, now);
+    return true;
+  }
+  bool was_valid = s_account_cache.flags[index] & ACCOUNT_CODE_VALID;
+  s_account_cache.flags[index] &= ~ACCOUNT_CODE_VALID;
+  return was_valid;
+}
+
+static void prv_set_account_info(size_t index, uint32_t period, uint8_t type, bool has_account_name, char initial) {
+  s_account_cache.initials[index] = initial;
+  s_account_cache.periods[index] = period > 0 && period <= UINT16_MAX ? period : DEFAULT_PERIOD;
+  s_account_cache.types[index] = type;
+  s_account_cache.cohorts[index] = type == OTP_TYPE_TOTP ? prv_get_cohort(s_account_cache.periods[index]) : NO_COHORT;
+  s_account_cache.flags[index] |= ACCOUNT_INFO_VALID | (has_account_name ? ACCOUNT_HAS_NAME : 0);
+}
+
+static void prv_load_account_info(size_t index) {
+  AccountInfo info;
+  if (!storage_load_account_info(s_account_cache.ids[index], &info)) {
     return;
   }
-  
-  if (!storage_load_account(index, cache->account)) {
-    free(cache->account);
-    cache->account = NULL;
+  prv_set_account_info(index, info.period, info.type, info.has_account_name, info.initial);
+}
+
+static void prv_release_account(int resident_index) {
+  int16_t row = s_resident_rows[resident_index];
+
+  // The code stays for drawing, it's regenerated once the row is loaded again
+  slab_free(s_account_slab, s_account_cache.accounts[row]);
+  s_account_cache.accounts[row] = NULL;
+  s_resident_rows[resident_index] = s_resident_rows[--s_resident_count];
+}
+
+static int prv_least_recently_used(void) {
+  int victim = -1;
+  for (int i = 0; i < s_resident_count; i++) {
+    if (victim < 0 || s_account_cache.last_used[s_resident_rows[i]] < s_account_cache.last_used[s_resident_rows[victim]]) {
+      victim = i;
+    }
+  }
+  return victim;
+}
+
+// Headers past the first screenful are read a few at a time between events,
+// so startup time doesn't grow with the number of accounts
+#define ACCOUNT_INFO_CHUNK_ROWS 8
+
+static AppTimer *s_info_timer = NULL;
+static size_t s_info_next_row = 0;
+static bool s_info_heights_changed = false;  // A background row got taller than assumed
+
+// Rows are ordered once per load, so the runs only change when the list is
+// loaded again after a sync or a reorder
+static void prv_build_jump_runs(void) {
+  s_account_cache.run_count = 0;
+  for (size_t row = 0; row < s_total_account_count; row++) {
+    if (row == 0 || s_account_cache.initials[row] != s_account_cache.initials[row - 1]) {
+      s_account_cache.run_starts[s_account_cache.run_count++] = row;
+    }
+  }
+}
+
+static void prv_load_info_chunk(void *data) {
+  s_info_timer = NULL;
+
+  size_t end = s_info_next_row + ACCOUNT_INFO_CHUNK_ROWS;
+  if (end > s_total_account_count) end = s_total_account_count;
+  for (; s_info_next_row < end; s_info_next_row++) {
+    // Rows drawn in the meantime have already loaded
+    if (s_account_cache.flags[s_info_next_row] & ACCOUNT_INFO_VALID) continue;
+    prv_load_account_info(s_info_next_row);
+    if (s_account_cache.flags[s_info_next_row] & ACCOUNT_HAS_NAME) {
+      s_info_heights_changed = true;
+    }
+  }
+
+  if (s_info_next_row < s_total_account_count) {
+    s_info_timer = app_timer_register(0, prv_load_info_chunk, NULL);
     return;
   }
-  
-  cache->code_valid = false;
-  memset(cache->code, 0, sizeof(cache->code));
+  prv_build_jump_runs();
+  if (s_info_heights_changed && s_list_layer) {
+    // Rows were laid out with the smallest height until now
+    account_list_layer_reload_data(s_list_layer);
+    s_info_heights_changed = false;
+  }
 }
 
-static void prv_free_account_cache(void) {
-  if (!s_account_cache) return;
+static TotpAccount *prv_load_account(size_t index) {
+  if (index >= s_total_account_count || !s_account_cache.accounts || !s_account_slab) return NULL;
   
-  for (size_t i = 0; i < s_total_account_count; i++) {
-    if (s_account_cache[i].account) {
-      free(s_account_cache[i].account);
-      s_account_cache[i].account = NULL;
+  if (s_account_cache.accounts[index]) {
+    s_account_cache.last_used[index] = ++s_lru_clock;
+    // Off-screen rows aren't refreshed by the tick, catch up when they are used
+    prv_refresh_code(index, time(NULL));
+    return s_account_cache.accounts[index];
+  }
+
+  ResidentAccount *resident = slab_alloc(s_account_slab);
+  if (!resident) {
+    int victim = prv_least_recently_used();
+    if (victim < 0) {
+      s_out_of_memory = true;
+      return NULL;
+    }
+    prv_release_account(victim);
+    resident = slab_alloc(s_account_slab);
+  }
+
+  TotpAccount *account = &resident->account;
+  if (!storage_load_account(s_account_cache.ids[index], account)) {
+    slab_free(s_account_slab, resident);
+    return NULL;
+  }
+  resident->render_width = 0;
+  s_resident_rows[s_resident_count++] = index;
+  s_account_cache.accounts[index] = account;
+  s_account_cache.last_used[index] = ++s_lru_clock;
+  if (!(s_account_cache.flags[index] & ACCOUNT_INFO_VALID)) {
+    prv_set_account_info(index, account->period, account->type, account->account_name[0] != '\0',
+                         storage_label_initial(account->label));
+    if (account->account_name[0] != '\0') {
+      // Laid out with the smallest height, relayout once the background loader is done
+      s_info_heights_changed = true;
+      if (!s_info_timer) {
+        s_info_timer = app_timer_register(0, prv_load_info_chunk, NULL);
+      }
     }
   }
+
+  // Code is stale if the time step changed while the account wasn't loaded
+  prv_refresh_code(index, time(NULL));
+  return account;
+}
+
+static void prv_prefetch_around(size_t row) {
+  size_t first = row > ACCOUNT_PREFETCH_ROWS ? row - ACCOUNT_PREFETCH_ROWS : 0;
+  for (size_t i = first; i <= row + ACCOUNT_PREFETCH_ROWS && i < s_total_account_count; i++) {
+    prv_load_account(i);
+  }
+}
+
+// A row counts as used once it stays selected for a while, scrolling past
+// doesn't count
+#define USAGE_DWELL_MS 2000
+
+static AppTimer *s_dwell_timer = NULL;
+
+static void prv_dwell_timer_callback(void *data) {
+  s_dwell_timer = NULL;
+  if (!s_list_layer) return;
+
+  uint16_t row = account_list_layer_get_selected_row(s_list_layer);
+  if (row < s_total_account_count && s_account_cache.accounts[row]) {
+    storage_usage_record(s_account_cache.ids[row], s_account_cache.accounts[row]);
+  }
+}
+
+static void prv_start_dwell(void) {
+  if (s_dwell_timer) {
+    app_timer_reschedule(s_dwell_timer, USAGE_DWELL_MS);
+  } else {
+    s_dwell_timer = app_timer_register(USAGE_DWELL_MS, prv_dwell_timer_callback, NULL);
+  }
+}
+
+// Make sure the slab has room for the current list, reusing it if the size
+// didn't change. With fewer blocks than the rows on screen plus the prefetch
+// rows every draw would evict an account it just loaded, so without room
+// for that many no accounts are loaded and rows are drawn from their headers.
+static void prv_prepare_account_slab(void) {
+  size_t capacity = s_total_account_count < ACCOUNT_POOL_SIZE ? s_total_account_count : ACCOUNT_POOL_SIZE;
+  size_t min_capacity = VISIBLE_ROWS_MAX + ACCOUNT_PREFETCH_ROWS;
+  if (min_capacity > capacity) {
+    min_capacity = capacity;
+  }
+  s_headers_only = false;
+  
+  if (s_account_slab && slab_get_capacity(s_account_slab) == capacity) {
+    slab_reset(s_account_slab);
+    return;
+  }
+  slab_destroy(s_account_slab);
+  s_account_slab = NULL;
+
+  // Leave what syncing and settings were measured to need, a smaller pool
+  // just loads more often. The minimum is tried even if it eats into that.
+  size_t available = heap_bytes_free();
+  size_t reserve = memory_get_reserve();
+  available = available > reserve ? available - reserve : 0;
+  if (capacity > available / sizeof(ResidentAccount)) {
+    capacity = available / sizeof(ResidentAccount);
+  }
+  if (capacity < min_capacity) {
+    capacity = min_capacity;
+  }
+  while (!s_account_slab) {
+    s_account_slab = slab_create(sizeof(ResidentAccount), capacity);
+    if (capacity == min_capacity) break;
+    capacity = capacity / 2 > min_capacity ? capacity / 2 : min_capacity;
+  }
+  
+  if (!s_account_slab) {
+    APP_LOG(APP_LOG_LEVEL_WARNING, "No room for accounts, showing headers only");
+    s_headers_only = true;
+  }
+}
+
+// All arrays share one allocation, widest elements first to keep them aligned
+static bool prv_alloc_account_arrays(size_t count) {
+  size_t size = count * (sizeof(uint64_t) + sizeof(TotpAccount *) + sizeof(uint32_t) +
+                         2 * sizeof(uint16_t) + 5 * sizeof(uint8_t) + sizeof(char) + sizeof(*s_account_cache.codes));
+  uint8_t *block = memory_calloc(1, size);
+  if (!block) return false;
+
+  s_account_cache.code_counters = (uint64_t *)block;
+  block += count * sizeof(uint64_t);
+  s_account_cache.accounts = (TotpAccount **)block;
+  block += count * sizeof(TotpAccount *);
+  s_account_cache.last_used = (uint32_t *)block;
+  block += count * sizeof(uint32_t);
+  s_account_cache.periods = (uint16_t *)block;
+  block += count * sizeof(uint16_t);
+  s_account_cache.remaining = (uint16_t *)block;
+  block += count * sizeof(uint16_t);
+  s_account_cache.types = block;
+  block += count;
+  s_account_cache.flags = block;
+  block += count;
+  s_account_cache.cohorts = block;
+  block += count;
+  s_account_cache.ids = block;
+  block += count;
+  s_account_cache.run_starts = block;
+  block += count;
+  s_account_cache.initials = (char *)block;
+  block += count;
+  s_account_cache.codes = (char (*)[MAX_DIGITS + 1])block;
+  return true;
+}
+
+static void prv_free_account_arrays(void) {
+  if (s_info_timer) {
+    app_timer_cancel(s_info_timer);
+    s_info_timer = NULL;
+  }
+  if (s_dwell_timer) {
+    app_timer_cancel(s_dwell_timer);
+    s_dwell_timer = NULL;
+  }
   
-  free(s_account_cache);
-  s_account_cache = NULL;
+  // code_counters is the start of the shared allocation
+  memory_free(s_account_cache.code_counters);
+  memset(&s_account_cache, 0, sizeof(s_account_cache));
+  s_resident_count = 0;
+  s_cohort_count = 0;
+}
+
+static void prv_free_account_cache(void) {
+  slab_destroy(s_account_slab);
+  s_account_slab = NULL;
+  prv_free_account_arrays();
 }
 
 static void prv_init_account_cache(void) {
-  prv_free_account_cache();
+  // The slab survives a resync, all its blocks are returned at once
+  prv_free_account_arrays();
+  s_out_of_memory = false;
   
-  if (s_total_account_count == 0) return;
+  if (s_total_account_count == 0) {
+    prv_free_account_cache();
+    return;
+  }
   
-  s_account_cache = calloc(s_total_account_count, sizeof(AccountCache));
-  if (!s_account_cache) {
+  if (!prv_alloc_account_arrays(s_total_account_count)) {
     APP_LOG(APP_LOG_LEVEL_ERROR, "Out of memory");
+    prv_free_account_cache();
     s_total_account_count = 0;
     s_out_of_memory = true;
+    return;
   }
+  prv_prepare_account_slab();
   
-  for (size_t i = 0; i < s_total_account_count; i++) {
-    prv_load_account(i);
-    if (heap_bytes_free() < MEMORY_CRITICAL_LEVEL) { // some extra memory for other stuff
-      s_out_of_memory = true;
-    }
-    if (s_out_of_memory) {
-      APP_LOG(APP_LOG_LEVEL_ERROR, "Out of memory, only %d accounts loaded", (int)i);
-      // Free only successfully loaded accounts (0 to i-1)
-      for (size_t j = 0; j < i; j++) {
-        if (s_account_cache[j].account) {
-          free(s_account_cache[j].account);
-        }
-      }
-      free(s_account_cache);
-      s_account_cache = NULL;
-      s_total_account_count = 0;
-      break;
+  // Rows are ordered once per load, so the list doesn't move while in use
+  if (storage_is_most_used_first_enabled()) {
+    storage_usage_get_order(s_account_cache.ids, s_total_account_count);
+  } else {
+    for (size_t i = 0; i < s_total_account_count; i++) {
+      s_account_cache.ids[i] = i;
     }
   }
+  
+  // Only headers are read here, full accounts are loaded when they scroll into view.
+  // The first screenful is read right away, the rest in the background.
+  size_t first_rows = s_total_account_count < ACCOUNT_POOL_SIZE ? s_total_account_count : ACCOUNT_POOL_SIZE;
+  for (size_t i = 0; i < first_rows; i++) {
+    prv_load_account_info(i);
+  }
+  s_info_next_row = first_rows;
+  s_info_heights_changed = false;
+  if (s_info_next_row < s_total_account_count) {
+    s_info_timer = app_timer_register(0, prv_load_info_chunk, NULL);
+  } else {
+    prv_build_jump_runs();
+  }
+  prv_prefetch_around(0);
+  prv_start_dwell();
+  memory_sample();
 }
 
 // ============================================================================
-// MenuLayer callbacks
+// Account list callbacks
 // ============================================================================
 
-static uint16_t prv_menu_get_num_rows_callback(MenuLayer *menu_layer, uint16_t section_index, void *data) {
-  (void)menu_layer;
-  (void)section_index;
-  (void)data;
+static uint16_t prv_list_get_num_rows_callback(void *context) {
+  (void)context;
   return s_total_account_count;
 }
 
-static int16_t prv_menu_get_cell_height_callback(MenuLayer *menu_layer, MenuIndex *cell_index, void *data) {
-  (void)menu_layer;
-  (void)data;
-  
-  AccountCache *cache = &s_account_cache[cell_index->row];
-  
+static int16_t prv_row_height(size_t row) {
   // Calculate height based on content
   int16_t height = 0 + 15; // top padding + label
   
-  if (cache->account &&cache->account->account_name[0] != '\0') {
+  if (s_account_cache.flags[row] & ACCOUNT_HAS_NAME) {
     height += 10; // account name
   }
   
@@ -123,112 +483,425 @@ static int16_t prv_menu_get_cell_height_callback(MenuLayer *menu_layer, MenuInde
   return height;
 }
 
-static void prv_menu_draw_row_callback(GContext* ctx, const Layer *cell_layer, MenuIndex *cell_index, void *data) {
-  (void)data;
+static int16_t prv_list_get_row_height_callback(uint16_t row, void *context) {
+  (void)context;
   
-  if (cell_index->row >= s_total_account_count) return;
-  
-  AccountCache *cache = &s_account_cache[cell_index->row];
-  if (!cache->account) {
-    menu_cell_basic_draw(ctx, cell_layer, "Error", "Failed to load", NULL);
+  return prv_row_height(row);
+}
+
+// Copy text, cut with an ellipsis if it doesn't fit on one line of the given width
+static void prv_fit_text(const char *text, GFont font, int16_t width, char *out, size_t out_size) {
+  GRect line = GRect(0, 0, INT16_MAX, 40);
+  size_t len = strlen(text);
+  if (graphics_text_layout_get_content_size(text, font, line, GTextOverflowModeFill, GTextAlignmentLeft).w <= width ||
+      len + sizeof(ELLIPSIS) > out_size) {
+    snprintf(out, out_size, "%s", text);
     return;
   }
+
+  // Longest prefix that fits with the ellipsis, cut on UTF-8 character boundaries
+  uint8_t cuts[LABEL_MAX_LEN > ACCOUNT_NAME_MAX_LEN ? LABEL_MAX_LEN : ACCOUNT_NAME_MAX_LEN];
+  size_t cut_count = 0;
+  for (size_t i = 1; i < len && cut_count < ARRAY_LENGTH(cuts); i++) {
+    if ((text[i] & 0xC0) != 0x80) {
+      cuts[cut_count++] = i;
+    }
+  }
+  size_t fit = 0;
+  size_t low = 0;
+  size_t high = cut_count;
+  while (low < high) {
+    size_t mid = (low + high) / 2;
+    snprintf(out, out_size, "%.*s" ELLIPSIS, (int)cuts[mid], text);
+    if (graphics_text_layout_get_content_size(out, font, line, GTextOverflowModeFill, GTextAlignmentLeft).w <= width) {
+      fit = cuts[mid];
+      low = mid + 1;
+    } else {
+      high = mid;
+    }
+  }
+  while (fit > 0 && text[fit - 1] == ' ') fit--;
+  snprintf(out, out_size, "%.*s" ELLIPSIS, (int)fit, text);
+}
+
+static void prv_build_render_cache(ResidentAccount *resident, int16_t width) {
+  prv_fit_text(resident->account.label, s_label_font, width, resident->label, sizeof(resident->label));
+  prv_fit_text(resident->account.account_name, s_account_name_font, width,
+               resident->account_name, sizeof(resident->account_name));
+  resident->render_width = width;
+}
+
+// Without a loaded account only the header is known, the initial stands in
+// for the label and there is no secret to generate a code from
+static void prv_draw_header_row(GContext *ctx, GRect frame, uint16_t row) {
+  if (!(s_account_cache.flags[row] & ACCOUNT_INFO_VALID)) {
+    prv_load_account_info(row);
+  }
+  char label[2 + sizeof(ELLIPSIS)];
+  char initial = s_account_cache.initials[row];
+  snprintf(label, sizeof(label), "%c" ELLIPSIS, initial ? initial : '#');
   
-  GRect bounds = layer_get_bounds(cell_layer);
-  int16_t y = 0;
+  int16_t y = frame.origin.y;
+  graphics_draw_text(ctx, label, s_label_font, GRect(4, y, frame.size.w - 8, 20),
+                     GTextOverflowModeFill, GTextAlignmentLeft, NULL);
+  y += 15;
+  if (s_account_cache.flags[row] & ACCOUNT_HAS_NAME) {
+    y += 10;
+  }
+  graphics_draw_text(ctx, "Low memory", s_label_font, GRect(0, y + 8, frame.size.w, 20),
+                     GTextOverflowModeTrailingEllipsis, GTextAlignmentCenter, NULL);
+  y += 35;
+
+  graphics_context_set_stroke_color(ctx, GColorBlack);
+  graphics_context_set_stroke_width(ctx, 1);
+  graphics_draw_line(ctx, GPoint(0, y), GPoint(frame.size.w, y));
+}
+
+static void prv_list_draw_row_callback(GContext* ctx, GRect frame, uint16_t row, void *context) {
+  (void)context;
+  
+  if (row >= s_total_account_count) return;
+  
+  GRect bounds = frame;
+  int16_t y = frame.origin.y;
   
   // Always use black text (no highlight visual feedback needed)
   graphics_context_set_text_color(ctx, GColorBlack);
+  
+  if (s_headers_only) {
+    prv_draw_header_row(ctx, frame, row);
+    return;
+  }
+  
+  PROFILE_START(start);
+  TotpAccount *account = prv_load_account(row);
+  if (!account) {
+    graphics_draw_text(ctx,
+                      s_out_of_memory ? "Error: Out of memory" : "Error: Failed to load",
+                      s_label_font,
+                      GRect(4, y, bounds.size.w - 8, bounds.size.h),
+                      GTextOverflowModeWordWrap,
+                      GTextAlignmentLeft,
+                      NULL);
+    return;
+  }
+  
+  // Strings are fitted once per load, they only change on sync
+  ResidentAccount *resident = (ResidentAccount *)account;
+  int16_t text_width = bounds.size.w - 8;
+  if (resident->render_width != text_width) {
+    prv_build_render_cache(resident, text_width);
+  }
+  
   graphics_draw_text(ctx,
-                    cache->account->label,
-                    fonts_get_system_font(FONT_KEY_GOTHIC_18_BOLD),
-                    GRect(4, y, bounds.size.w - 8, 20),
-                    GTextOverflowModeTrailingEllipsis,
+                    resident->label,
+                    s_label_font,
+                    GRect(4, y, text_width, 20),
+                    GTextOverflowModeFill,
                     GTextAlignmentLeft,
                     NULL);
   y += 15;
   
   // Draw account name (if present)
-  if (cache->account->account_name[0] != '\0') {
+  if (resident->account_name[0] != '\0') {
     graphics_draw_text(ctx,
-                      cache->account->account_name,
-                      fonts_get_system_font(FONT_KEY_GOTHIC_14),
-                      GRect(4, y, bounds.size.w - 8, 16),
-                      GTextOverflowModeTrailingEllipsis,
+                      resident->account_name,
+                      s_account_name_font,
+                      GRect(4, y, text_width, 16),
+                      GTextOverflowModeFill,
                       GTextAlignmentLeft,
                       NULL);
     y += 10;
   }
   
   // Draw TOTP code (large, centered)
-  const char *code_text = cache->code_valid ? cache->code : "------";
-  graphics_draw_text(ctx,
-                    code_text,
-                    fonts_get_system_font(FONT_KEY_GOTHIC_28_BOLD),
-                    GRect(0, y, bounds.size.w, 34),
-                    GTextOverflowModeTrailingEllipsis,
-                    GTextAlignmentCenter,
-                    NULL);
+  const char *code_text = (s_account_cache.flags[row] & ACCOUNT_CODE_VALID) ? s_account_cache.codes[row] : "------";
+  if (account->type == OTP_TYPE_HOTP && s_account_cache.codes[row][0] == '\0') {
+    code_text = "Hold SELECT";
+  }
+  GRect code_frame = GRect(0, y, bounds.size.w, 34);
+  if (!code_renderer_draw(ctx, code_text, code_frame)) {
+    graphics_draw_text(ctx,
+                      code_text,
+                      s_code_font,
+                      code_frame,
+                      GTextOverflowModeTrailingEllipsis,
+                      GTextAlignmentCenter,
+                      NULL);
+  }
   y += 35;
 
+  // The countdown bar on this line is drawn by the progress layer
   graphics_context_set_stroke_color(ctx, GColorBlack);
-  graphics_context_set_stroke_width(ctx, 5);
-  graphics_draw_line(ctx, GPoint(0, y), GPoint(cache->remaining * bounds.size.w / cache->account->period, y));
   graphics_context_set_stroke_width(ctx, 1);
   graphics_draw_line(ctx, GPoint(0, y), GPoint(bounds.size.w, y));
+  PROFILE_STOP(PROFILE_DRAW_ROW, start);
+}
+
+// ============================================================================
+// Countdown progress layer
+// ============================================================================
+//
+// The countdown bars change every second while codes change only once per
+// period, so they are drawn by a transparent layer on top of the list that
+// can be marked dirty on its own. Bars are placed from the list's row frames.
+
+#define PROGRESS_BAR_WIDTH 5
+
+static void prv_progress_layer_update_proc(Layer *layer, GContext *ctx) {
+  if (!s_list_layer || !s_account_cache.periods) return;
+
+  GRect bounds = layer_get_bounds(layer);
+  uint16_t first, last;
+  if (!account_list_layer_get_visible_rows(s_list_layer, &first, &last)) return;
+
+  for (uint16_t row = first; row <= last; row++) {
+    if (!(s_account_cache.flags[row] & ACCOUNT_INFO_VALID) || s_account_cache.types[row] != OTP_TYPE_TOTP) {
+      continue;
+    }
+    GRect frame = account_list_layer_get_row_frame(s_list_layer, row);
+    int16_t y = frame.origin.y + frame.size.h - 1;  // On the row's bottom line
+
+    graphics_context_set_stroke_color(ctx, GColorBlack);
+    graphics_context_set_stroke_width(ctx, PROGRESS_BAR_WIDTH);
+    graphics_draw_line(ctx, GPoint(0, y), GPoint(s_account_cache.remaining[row] * bounds.size.w / s_account_cache.periods[row], y));
+  }
+  graphics_context_set_stroke_width(ctx, 1);
+}
+
+static void prv_create_progress_layer(Layer *window_layer, GRect frame) {
+  s_progress_layer = layer_create(frame);
+  layer_set_update_proc(s_progress_layer, prv_progress_layer_update_proc);
+  layer_add_child(window_layer, s_progress_layer);
+}
+
+static void prv_destroy_progress_layer(void) {
+  if (s_progress_layer) {
+    layer_destroy(s_progress_layer);
+    s_progress_layer = NULL;
+  }
+}
+
+// ============================================================================
+// Refresh scheduling
+// ============================================================================
+//
+// By default the codes are refreshed on every second tick. In low power mode
+// the app sleeps until the visible codes are about to change, waking once to
+// start the countdown vibration and once when the codes change. The
+// countdown bars jump in between.
+
+static void prv_refresh_timer_callback(void *data) {
+  s_refresh_timer = NULL;
+  ui_update_codes();
+}
+
+static void prv_schedule_refresh(uint32_t seconds) {
+  if (seconds == 0) {
+    if (s_refresh_timer) {
+      app_timer_cancel(s_refresh_timer);
+      s_refresh_timer = NULL;
+    }
+    return;
+  }
+
+  // Wake just after the second changes
+  uint16_t ms = time_ms(NULL, NULL);
+  uint32_t delay = seconds * 1000 - ms + 10;
+  if (!s_refresh_timer || !app_timer_reschedule(s_refresh_timer, delay)) {
+    s_refresh_timer = app_timer_register(delay, prv_refresh_timer_callback, NULL);
+  }
+}
+
+static bool prv_is_low_power(void) {
+  return s_low_power_refresh || activity_is_idle();
+}
+
+static void prv_start_refresh(void) {
+  if (activity_is_paused()) {
+    // Restarted when the focus comes back
+    return;
+  }
+  if (prv_is_low_power()) {
+    tick_timer_service_unsubscribe();
+    ui_update_codes();  // Schedules the first wakeup
+  } else {
+    prv_schedule_refresh(0);
+    tick_timer_service_subscribe(SECOND_UNIT, ui_tick_handler);
+  }
+}
+
+static void prv_stop_refresh(void) {
+  tick_timer_service_unsubscribe();
+  prv_schedule_refresh(0);
+}
+
+// ============================================================================
+// Idle policy
+// ============================================================================
+//
+// See activity.h. Nothing is refreshed while paused, idle falls back to low
+// power refreshing.
+
+static void prv_activity_changed(void *context) {
+  if (!s_window) return;
+  if (activity_is_paused()) {
+    prv_stop_refresh();
+  } else {
+    prv_start_refresh();
+  }
 }
 
 // ============================================================================
 // Code generation and updates
 // ============================================================================
 
+// Rows on screen and the selected one the list may be scrolling to, plus a
+// few more in the direction the list is scrolling
+static void prv_get_refresh_range(size_t *first, size_t *last) {
+  uint16_t selected = account_list_layer_get_selected_row(s_list_layer);
+  uint16_t visible_first, visible_last;
+  if (!account_list_layer_get_visible_rows(s_list_layer, &visible_first, &visible_last)) {
+    visible_first = visible_last = selected;
+  }
+  *first = visible_first < selected ? visible_first : selected;
+  *last = visible_last > selected ? visible_last : selected;
+
+  if (s_scroll_direction < 0) {
+    *first = *first > ACCOUNT_PREFETCH_ROWS ? *first - ACCOUNT_PREFETCH_ROWS : 0;
+  } else {
+    *last = *last + ACCOUNT_PREFETCH_ROWS < s_total_account_count ? *last + ACCOUNT_PREFETCH_ROWS : s_total_account_count - 1;
+  }
+}
+
+// Seconds counted down by vibration before visible codes change
+#define VIBE_LEAD_SECONDS 2
+
+static time_t s_vibe_boundary = 0;  // Boundary the last countdown pattern was played for
+
+// One pattern buzzes through the last seconds up to the boundary, cohorts
+// changing at the same time share it
+static void prv_schedule_vibe(time_t now, uint32_t remaining, uint32_t period) {
+  if (activity_is_idle() || s_locked) return;
+  
+  uint32_t lead = remaining % period;  // 0 right at the boundary
+  if (lead > VIBE_LEAD_SECONDS || now + lead == s_vibe_boundary) return;
+  s_vibe_boundary = now + lead;
+
+  static const uint32_t segments[] = { 50, 950, 50, 950, 50 };
+  VibePattern pat = {
+    .durations = segments,
+    .num_segments = lead * 2 + 1,
+  };
+  vibes_enqueue_custom_pattern(pat);
+}
+
+// Seconds until the next wakeup needed for a row with this much time left
+static uint32_t prv_next_wakeup(uint32_t remaining) {
+  if (activity_is_idle()) return remaining;  // No countdown vibration to start
+  return remaining > VIBE_LEAD_SECONDS ? remaining - VIBE_LEAD_SECONDS : remaining;
+}
+
 void ui_update_codes(void) {
-  if (!s_account_cache || s_total_account_count == 0) return;
+  if (!s_account_cache.periods || s_total_account_count == 0) {
+    prv_schedule_refresh(0);
+    return;
+  }
   
+  PROFILE_START(start);
+  TRACE_BEGIN(TRACE_TICK, 0);
+  uint32_t started = profile_now();
   time_t now = time(NULL);
-  bool needs_redraw = false;
-  bool needs_vibe = false;
+  bool codes_changed = false;
+  uint32_t next_refresh = 0;  // Seconds until a refreshed row needs a wakeup, 0 if none
+  uint8_t visible_cohorts = 0;  // Bit per cohort with a refreshed row
   
-  for (size_t i = 0; i < s_total_account_count; i++) {
-    AccountCache *cache = &s_account_cache[i];
-    if (!cache->account) continue;
+  // Other rows catch up when they scroll into view
+  size_t first, last;
+  prv_get_refresh_range(&first, &last);
+  for (size_t i = first; i <= last; i++) {
+    codes_changed |= prv_refresh_code(i, now);
+
+    if (s_account_cache.types[i] != OTP_TYPE_TOTP || !(s_account_cache.flags[i] & ACCOUNT_INFO_VALID)) continue;
     
-    if (!totp_generate(cache->account, now, cache->code, sizeof(cache->code), NULL)) {
-      snprintf(cache->code, sizeof(cache->code), "ERROR");
-      cache->code_valid = false;
-    } else {
-      cache->code_valid = true;
+    if (s_account_cache.cohorts[i] != NO_COHORT) {
+      visible_cohorts |= 1 << s_account_cache.cohorts[i];
+      continue;
+    }
+    uint32_t remaining = s_account_cache.remaining[i];
+    prv_schedule_vibe(now, remaining, s_account_cache.periods[i]);
+    uint32_t wait = prv_next_wakeup(remaining);
+    if (next_refresh == 0 || wait < next_refresh) {
+      next_refresh = wait;
     }
+  }
+  
+  for (uint8_t c = 0; c < s_cohort_count; c++) {
+    if (!(visible_cohorts & (1 << c))) continue;
     
-    // Calculate time remaining
-    uint32_t period = cache->account->period > 0 ? cache->account->period : DEFAULT_PERIOD;
-    uint32_t elapsed = (uint32_t)(now % period);
-    cache->remaining = period - elapsed;
-    if (cache->remaining == 0) {
-      cache->remaining = period;
-      needs_vibe = true;
-    }    
-    if (cache->remaining <= 2 || cache->remaining == period) {
-      needs_vibe = true;
+    prv_schedule_vibe(now, s_cohorts[c].remaining, s_cohorts[c].period);
+    uint32_t wait = prv_next_wakeup(s_cohorts[c].remaining);
+    if (next_refresh == 0 || wait < next_refresh) {
+      next_refresh = wait;
     }
-
-    needs_redraw = true;
   }
   
-  if (needs_redraw && s_menu_layer) {
-    layer_mark_dirty(menu_layer_get_layer(s_menu_layer));
+  if (prv_is_low_power() && !activity_is_paused()) {
+    prv_schedule_refresh(next_refresh);
+  }
+  
+  // Rows only need repainting when a code changed, otherwise just the bars
+  if (codes_changed && s_list_layer) {
+    layer_mark_dirty(account_list_layer_get_layer(s_list_layer));
+  } else if (s_progress_layer) {
+    layer_mark_dirty(s_progress_layer);
+  }
+  PROFILE_STOP(PROFILE_UPDATE_CODES, start);
+  TRACE_END(TRACE_TICK, 0);
+  diagnostics_record_refresh(started);
+}
+
+void ui_set_low_power_refresh(bool enabled) {
+  s_low_power_refresh = enabled;
+  if (s_window) {
+    prv_start_refresh();
   }
+}
 
-  if (needs_vibe) {
-    uint32_t const segments[] = { 50 };
-    VibePattern pat = {
-      .durations = segments,
-      .num_segments = ARRAY_LENGTH(segments),
-    };    
-    vibes_enqueue_custom_pattern(pat);
+void ui_reorder_accounts(void) {
+  if (s_total_account_count > 0) {
+    ui_set_total_count(s_total_account_count);
   }
 }
 
+TotpAccount *ui_get_selected_account(size_t *out_id) {
+  if (!s_list_layer) return NULL;
+
+  uint16_t row = account_list_layer_get_selected_row(s_list_layer);
+  TotpAccount *account = prv_load_account(row);
+  if (account && out_id) {
+    *out_id = s_account_cache.ids[row];
+  }
+  return account;
+}
+
+bool ui_get_selected_row(size_t *out_id, OtpType *out_type) {
+  if (!s_list_layer || !s_account_cache.periods || s_total_account_count == 0) return false;
+
+  uint16_t row = account_list_layer_get_selected_row(s_list_layer);
+  if (!(s_account_cache.flags[row] & ACCOUNT_INFO_VALID)) {
+    prv_load_account_info(row);
+    if (!(s_account_cache.flags[row] & ACCOUNT_INFO_VALID)) return false;
+  }
+  *out_id = s_account_cache.ids[row];
+  *out_type = s_account_cache.types[row];
+  return true;
+}
+
+size_t ui_get_resident_count(void) {
+  return s_resident_count;
+}
+
 void ui_tick_handler(struct tm *tick_time, TimeUnits units_changed) {
   ui_update_codes();
 }
@@ -238,7 +911,7 @@ void ui_tick_handler(struct tm *tick_time, TimeUnits units_changed) {
 // ============================================================================
 
 static void prv_update_empty_state(void) {
-  if (!s_empty_layer || !s_menu_layer) return;
+  if (!s_empty_layer || !s_list_layer) return;
   
   bool has_accounts = s_total_account_count > 0;
   
@@ -247,6 +920,8 @@ static void prv_update_empty_state(void) {
   if (!has_accounts) {
     if (s_out_of_memory) {
       text = "Out of memory.\nPlease remove some accounts.";
+    } else if (s_storage_full) {
+      text = "Not enough storage.\nPlease remove some accounts.";
     } else if (s_is_loading) {
       text = "Loading...";
     } else {
@@ -271,7 +946,10 @@ static void prv_update_empty_state(void) {
   layer_set_frame(layer, GRect(0, bounds.size.h / 2 - size.h / 2, bounds.size.w, size.h));  
   
   layer_set_hidden(layer, has_accounts);
-  layer_set_hidden(menu_layer_get_layer(s_menu_layer), !has_accounts);
+  layer_set_hidden(account_list_layer_get_layer(s_list_layer), !has_accounts);
+  if (s_progress_layer) {
+    layer_set_hidden(s_progress_layer, !has_accounts);
+  }
 }
 
 // ============================================================================
@@ -281,24 +959,68 @@ static void prv_update_empty_state(void) {
 void ui_set_total_count(size_t count) {
   s_total_account_count = count;
   s_is_loading = false;
+  s_sync_pending = false;
   prv_init_account_cache();
   
-  if (s_menu_layer) {
-    menu_layer_reload_data(s_menu_layer);
+  if (s_list_layer) {
+    account_list_layer_reload_data(s_list_layer);
   }
   
   prv_update_empty_state();
   ui_update_codes();
 }
 
+void ui_discard_accounts(void) {
+  prv_free_account_cache();
+}
+
+void ui_set_synced_count(size_t count) {
+  if (!s_locked && (s_window || s_account_cache.periods)) {
+    ui_set_total_count(count);
+    return;
+  }
+
+  // Preloaded accounts belong to the old list, the new one is loaded on
+  // unlock. Behind a pinned account nothing is loaded, the list loads the
+  // new one when it opens.
+  s_total_account_count = count;
+  s_is_loading = false;
+  if (s_account_cache.periods) {
+    prv_free_account_cache();
+    s_sync_pending = true;
+  }
+}
+
+void ui_set_locked(bool locked) {
+  s_locked = locked;
+  if (locked) return;
+
+  if (s_sync_pending) {
+    s_sync_pending = false;
+    ui_set_total_count(s_total_account_count);
+  } else {
+    // Start the countdown vibration skipped while locked
+    ui_update_codes();
+  }
+}
+
 void ui_set_loading(bool loading) {
   s_is_loading = loading;
   prv_update_empty_state();
 }
 
+void ui_set_storage_full(bool full) {
+  if (full && !s_storage_full && s_total_account_count > 0 && !s_locked) {
+    // The current list stays on screen, make the failure noticeable
+    vibes_long_pulse();
+  }
+  s_storage_full = full;
+  prv_update_empty_state();
+}
+
 void ui_reload_data(void) {
-  if (s_menu_layer) {
-    menu_layer_reload_data(s_menu_layer);
+  if (s_list_layer) {
+    account_list_layer_reload_data(s_list_layer);
   }
 }
 
@@ -315,9 +1037,11 @@ void ui_reload_window(void) {
     s_status_bar = NULL;
   }
   
-  if (s_menu_layer) {
-    menu_layer_destroy(s_menu_layer);
-    s_menu_layer = NULL;
+  prv_destroy_progress_layer();
+  
+  if (s_list_layer) {
+    account_list_layer_destroy(s_list_layer);
+    s_list_layer = NULL;
   }
   
   if (s_empty_layer) {
@@ -350,21 +1074,23 @@ void ui_reload_window(void) {
     );
   }
   
-  // Create menu layer
-  s_menu_layer = menu_layer_create(content_bounds);
-  menu_layer_set_callbacks(s_menu_layer, NULL, (MenuLayerCallbacks){
-    .get_num_rows = prv_menu_get_num_rows_callback,
-    .get_cell_height = prv_menu_get_cell_height_callback,
-    .draw_row = prv_menu_draw_row_callback,
-    .select_click = prv_menu_select_callback,
+  // Create account list layer
+  s_list_layer = account_list_layer_create(content_bounds);
+  account_list_layer_set_callbacks(s_list_layer, NULL, (AccountListLayerCallbacks){
+    .get_num_rows = prv_list_get_num_rows_callback,
+    .get_row_height = prv_list_get_row_height_callback,
+    .draw_row = prv_list_draw_row_callback,
+    .select_click = prv_list_select_callback,
+    .select_long_click = prv_list_select_long_callback,
+    .selection_changed = prv_list_selection_changed_callback,
+    .get_jump_row = prv_list_get_jump_row_callback,
   });
+  account_list_layer_reload_data(s_list_layer);
   
-  // Disable highlight by making it the same color as background
-  menu_layer_set_highlight_colors(s_menu_layer, GColorWhite, GColorBlack);
-  
-  menu_layer_set_click_config_onto_window(s_menu_layer, s_window);
+  account_list_layer_set_click_config_onto_window(s_list_layer, s_window);
   
-  layer_add_child(window_layer, menu_layer_get_layer(s_menu_layer));
+  layer_add_child(window_layer, account_list_layer_get_layer(s_list_layer));
+  prv_create_progress_layer(window_layer, content_bounds);
   
   // Create empty state label
   s_empty_layer = text_layer_create(content_bounds);
@@ -379,11 +1105,74 @@ void ui_reload_window(void) {
 }
 
 // ============================================================================
-// Menu callbacks
+// Jump targets
 // ============================================================================
+//
+// A long UP/DOWN press moves between runs of rows with the same first
+// letter, in row order, so it follows whatever order the list is in. Once
+// the background loader has read every header a jump is a lookup in the
+// run starts, until then the rows are scanned.
+
+// Headers the background loader hasn't reached yet are read on the way
+static char prv_row_initial(uint16_t row) {
+  if (!(s_account_cache.flags[row] & ACCOUNT_INFO_VALID)) {
+    prv_load_account_info(row);
+    if (s_account_cache.flags[row] & ACCOUNT_HAS_NAME) {
+      s_info_heights_changed = true;
+      if (!s_info_timer) {
+        s_info_timer = app_timer_register(0, prv_load_info_chunk, NULL);
+      }
+    }
+  }
+  return s_account_cache.initials[row];
+}
+
+// DOWN goes to the next row with another letter. UP goes to the start of
+// the current run, or of the run above when already at its start.
+static uint16_t prv_get_jump_row(uint16_t row, int direction) {
+  if (row >= s_total_account_count || !s_account_cache.initials) return row;
+
+  // Run starts are known once every header is read
+  if (s_account_cache.run_count > 0) {
+    const uint8_t *starts = s_account_cache.run_starts;
+    if (direction > 0) {
+      for (uint8_t i = 0; i < s_account_cache.run_count; i++) {
+        if (starts[i] > row) return starts[i];
+      }
+      return s_total_account_count - 1;
+    }
+    for (int i = s_account_cache.run_count - 1; i >= 0; i--) {
+      if (starts[i] < row) return starts[i];
+    }
+    return 0;
+  }
+
+  // Still loading, scan the rows
+  if (direction > 0) {
+    char initial = prv_row_initial(row);
+    uint16_t next = row + 1;
+    while (next < s_total_account_count && prv_row_initial(next) == initial) {
+      next++;
+    }
+    return next < s_total_account_count ? next : s_total_account_count - 1;
+  }
+
+  if (row == 0) return 0;
+  uint16_t start = row - 1;
+  char initial = prv_row_initial(start);
+  while (start > 0 && prv_row_initial(start - 1) == initial) {
+    start--;
+  }
+  return start;
+}
 
-static void prv_menu_select_callback(MenuLayer *menu_layer, MenuIndex *cell_index, void *data) {
-  // Open settings window on any menu item click
+// ============================================================================
+// List click callbacks
+// ============================================================================
+
+static void prv_list_select_callback(uint16_t row, void *context) {
+  // Open settings window on any list item click, the window ends the phase on unload
+  memory_phase_begin(MEMORY_PHASE_SETTINGS);
   if (!s_settings_window) {
     s_settings_window = settings_window_create();
   }
@@ -393,6 +1182,41 @@ static void prv_menu_select_callback(MenuLayer *menu_layer, MenuIndex *cell_inde
   }
 }
 
+static uint16_t prv_list_get_jump_row_callback(uint16_t row, int direction, void *context) {
+  (void)context;
+  return prv_get_jump_row(row, direction);
+}
+
+static void prv_list_selection_changed_callback(uint16_t new_row, uint16_t old_row, void *context) {
+  s_scroll_direction = new_row < old_row ? -1 : 1;
+  prv_start_dwell();
+  if (prv_is_low_power()) {
+    // Rows scrolling into view may need an earlier wakeup
+    ui_update_codes();
+  }
+  // Load the rows about to scroll into view before they are drawn
+  prv_prefetch_around(new_row);
+}
+
+static void prv_list_select_long_callback(uint16_t row, void *context) {
+  if (row >= s_total_account_count) return;
+
+  TotpAccount *account = prv_load_account(row);
+  if (!account || account->type != OTP_TYPE_HOTP) return;
+
+  // Each hold consumes a counter value, persisted only once per block
+  uint64_t counter;
+  char *code = s_account_cache.codes[row];
+  if (storage_hotp_next_counter(account, &counter) &&
+      hotp_generate(account, counter, code, sizeof(s_account_cache.codes[row]))) {
+    s_account_cache.flags[row] |= ACCOUNT_CODE_VALID;
+  } else {
+    snprintf(code, sizeof(s_account_cache.codes[row]), "ERROR");
+    s_account_cache.flags[row] &= ~ACCOUNT_CODE_VALID;
+  }
+  layer_mark_dirty(account_list_layer_get_layer(s_list_layer));
+}
+
 // ============================================================================
 // Window lifecycle
 // ============================================================================
@@ -419,21 +1243,23 @@ static void prv_window_load(Window *window) {
     );
   }
   
-  // Create menu layer
-  s_menu_layer = menu_layer_create(content_bounds);
-  menu_layer_set_callbacks(s_menu_layer, NULL, (MenuLayerCallbacks){
-    .get_num_rows = prv_menu_get_num_rows_callback,
-    .get_cell_height = prv_menu_get_cell_height_callback,
-    .draw_row = prv_menu_draw_row_callback,
-    .select_click = prv_menu_select_callback,
+  // Create account list layer
+  s_list_layer = account_list_layer_create(content_bounds);
+  account_list_layer_set_callbacks(s_list_layer, NULL, (AccountListLayerCallbacks){
+    .get_num_rows = prv_list_get_num_rows_callback,
+    .get_row_height = prv_list_get_row_height_callback,
+    .draw_row = prv_list_draw_row_callback,
+    .select_click = prv_list_select_callback,
+    .select_long_click = prv_list_select_long_callback,
+    .selection_changed = prv_list_selection_changed_callback,
+    .get_jump_row = prv_list_get_jump_row_callback,
   });
+  account_list_layer_reload_data(s_list_layer);
   
-  // Disable highlight by making it the same color as background
-  menu_layer_set_highlight_colors(s_menu_layer, GColorWhite, GColorBlack);
-  
-  menu_layer_set_click_config_onto_window(s_menu_layer, window);
+  account_list_layer_set_click_config_onto_window(s_list_layer, window);
   
-  layer_add_child(window_layer, menu_layer_get_layer(s_menu_layer));
+  layer_add_child(window_layer, account_list_layer_get_layer(s_list_layer));
+  prv_create_progress_layer(window_layer, content_bounds);
   
   // Create empty state label
   s_empty_layer = text_layer_create(content_bounds);
@@ -449,9 +1275,11 @@ static void prv_window_unload(Window *window) {
     s_status_bar = NULL;
   }
   
-  if (s_menu_layer) {
-    menu_layer_destroy(s_menu_layer);
-    s_menu_layer = NULL;
+  prv_destroy_progress_layer();
+  
+  if (s_list_layer) {
+    account_list_layer_destroy(s_list_layer);
+    s_list_layer = NULL;
   }
   
   if (s_empty_layer) {
@@ -467,6 +1295,12 @@ static void prv_window_unload(Window *window) {
 // ============================================================================
 
 void ui_init(void) {
+  s_label_font = fonts_get_system_font(FONT_KEY_GOTHIC_18_BOLD);
+  s_account_name_font = fonts_get_system_font(FONT_KEY_GOTHIC_14);
+  s_code_font = fonts_get_system_font(FONT_KEY_GOTHIC_28_BOLD);
+  // Codes fall back to text if the atlas can't be loaded
+  code_renderer_init();
+  
   s_window = window_create();
   window_set_background_color(s_window, GColorWhite);
   window_set_window_handlers(s_window, (WindowHandlers) {
@@ -475,11 +1309,14 @@ void ui_init(void) {
   });
   window_stack_push(s_window, true);
   
-  tick_timer_service_subscribe(SECOND_UNIT, ui_tick_handler);
+  s_low_power_refresh = storage_is_low_power_refresh_enabled();
+  prv_start_refresh();
+  activity_subscribe(prv_activity_changed, NULL);
 }
 
 void ui_deinit(void) {
-  tick_timer_service_unsubscribe();
+  prv_stop_refresh();
+  activity_unsubscribe(prv_activity_changed, NULL);
   
   if (s_settings_window) {
     settings_window_destroy(s_settings_window);
@@ -493,6 +1330,8 @@ void ui_deinit(void) {
   
   // Free account cache to prevent memory leak
   prv_free_account_cache();
+  
+  code_renderer_deinit();
 }
 
 
@@ -2,22 +2,43 @@
 
 #include <pebble.h>
 #include "totp.h"
+#include "account_list_layer.h"
 
 #define MAX_DIGITS 8
 
+// AccountCache flags
+#define ACCOUNT_INFO_VALID  (1 << 0)  // Metadata has been read from storage
+#define ACCOUNT_HAS_NAME    (1 << 1)
+#define ACCOUNT_CODE_VALID  (1 << 2)  // Code has been generated
+
+// Per-row state, kept as parallel arrays so the per-second refresh only
+// walks the few bytes it needs for each row. Secrets and strings live in
+// separately loaded TotpAccounts that are only resident near the view.
 typedef struct {
-  TotpAccount *account;  // Pointer to loaded account (NULL if not loaded)
-  char code[9];  // Buffer for TOTP code (max 8 digits + null)
-  uint32_t remaining;
-  bool code_valid;  // Whether code has been generated
+  uint8_t *ids;  // Storage ID shown in each row
+  // Read by every refresh
+  uint16_t *periods;
+  uint8_t *types;  // OtpType
+  uint8_t *cohorts;  // Period cohort of each TOTP row, shares its time math
+  uint64_t *code_counters;  // Time step each code was generated for
+  uint8_t *flags;  // ACCOUNT_* flags
+  char *initials;  // First letter for long press jumps, 0 until the header is read
+  uint8_t *run_starts;  // First row of each run of equal initials
+  uint8_t run_count;  // Runs in run_starts, 0 until every header is read
+  // Written by the refresh, read when drawing
+  uint16_t *remaining;
+  char (*codes)[MAX_DIGITS + 1];
+  // Resident accounts
+  TotpAccount **accounts;  // NULL if not resident
+  uint32_t *last_used;  // LRU stamp while resident
 } AccountCache;
 
 // UI global variables
 extern Window *s_window;
-extern MenuLayer *s_menu_layer;
+extern AccountListLayer *s_list_layer;
 extern TextLayer *s_empty_layer;
 extern size_t s_total_account_count;
-extern AccountCache *s_account_cache;  // dynamic array of cached account data
+extern AccountCache s_account_cache;  // arrays of s_total_account_count entries
 
 // UI initialization
 void ui_init(void);
@@ -28,9 +49,22 @@ void ui_deinit(void);
 // Set total account count and reload menu
 void ui_set_total_count(size_t count);
 
+// Free loaded accounts and codes, they are reloaded by ui_set_total_count
+void ui_discard_accounts(void);
+
+// A sync replaced the list. While locked or before the list is loaded
+// only the count is kept, the list is loaded on unlock or when it opens.
+void ui_set_synced_count(size_t count);
+
+// Locked while the PIN is entered, nothing vibrates and syncs wait
+void ui_set_locked(bool locked);
+
 // Set loading state
 void ui_set_loading(bool loading);
 
+// Report that the last synced list didn't fit into persistent storage
+void ui_set_storage_full(bool full);
+
 // Update codes for all accounts
 void ui_update_codes(void);
 
@@ -40,5 +74,21 @@ void ui_reload_data(void);
 // Reload window (to apply settings changes like status bar)
 void ui_reload_window(void);
 
+// Switch between per-second and low power refreshing
+void ui_set_low_power_refresh(bool enabled);
+
+// Order the rows again after the list order setting changed
+void ui_reorder_accounts(void);
+
+// Accounts currently loaded with their secrets
+size_t ui_get_resident_count(void);
+
+// Account of the selected row and its storage ID, NULL if not loaded
+TotpAccount *ui_get_selected_account(size_t *out_id);
+
+// Storage ID and type of the selected row from its header, without
+// loading the account, false if there is no selected row
+bool ui_get_selected_row(size_t *out_id, OtpType *out_type);
+
 // Tick handler (update every second)
 void ui_tick_handler(struct tm *tick_time, TimeUnits units_changed);
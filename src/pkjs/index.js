@@ -224,7 +224,7 @@ const CONFIG_HTML = `
         '<span class="drag-handle">⋮⋮</span>',
         '<div class="entry-content">',
           '<div class="entry-label">' + escapeHtml(entry.label || 'Unnamed') + '</div>',
-          '<div class="entry-account">' + escapeHtml(entry.account_name || '') + '</div>',
+          '<div class="entry-account">' + escapeHtml(entry.account_name || '') + (entry.type === 'hotp' ? ' (HOTP)' : '') + '</div>',
         '</div>',
         '<button type="button" class="entry-remove">×</button>'
       ].join('');
@@ -330,7 +330,11 @@ const CONFIG_HTML = `
     function buildPayload(list) {
       return list.map(function(item) {
         var algo = item.algorithm !== undefined ? item.algorithm : 0;
-        return [item.label, item.account_name, item.secret, item.period, item.digits, algo].join('|');
+        var fields = [item.label, item.account_name, item.secret, item.period, item.digits, algo];
+        if (item.type === 'hotp') {
+          fields.push(1, item.counter || 0);
+        }
+        return fields.join('|');
       }).join(';');
     }
 
@@ -450,6 +454,7 @@ const CONFIG_HTML = `
       var algorithm = 0;
       var digits = 6;
       var type = 2; // TOTP (default)
+      var counter = 0;
       
       var pos = 0;
       while (pos < data.length) {
@@ -518,6 +523,8 @@ const CONFIG_HTML = `
             }
           } else if (fieldNumber === 6) { // type
             type = value;
+          } else if (fieldNumber === 7) { // counter
+            counter = value;
           }
         } else if (wireType === 1) { // 64-bit
           if (pos + 8 > data.length) {
@@ -538,9 +545,7 @@ const CONFIG_HTML = `
         throw new Error('No secret found in OTP parameters');
       }
       
-      if (type === 1) {
-        throw new Error('HOTP is not supported, only TOTP');
-      } else if (type !== 2 && type !== 0) {
+      if (type !== 1 && type !== 2 && type !== 0) {
         throw new Error('Unknown OTP type: ' + type);
       }
       
@@ -560,7 +565,9 @@ const CONFIG_HTML = `
         secret: secret,
         period: 30,
         digits: digits,
-        algorithm: algorithm
+        algorithm: algorithm,
+        type: type === 1 ? 'hotp' : 'totp',
+        counter: counter
       };
     }
     
@@ -603,8 +610,8 @@ const CONFIG_HTML = `
         }
 
         var type = url.hostname;
-        if (type !== 'totp') {
-          throw new Error('Only TOTP is supported');
+        if (type !== 'totp' && type !== 'hotp') {
+          throw new Error('Only TOTP and HOTP are supported');
         }
 
         var params = {};
@@ -628,6 +635,7 @@ const CONFIG_HTML = `
         var secret = (params.secret || '').toUpperCase().replace(/[^A-Z2-7]/g, '');
         var digits = parseInt(params.digits, 10) || 6;
         var period = parseInt(params.period, 10) || 30;
+        var counter = parseInt(params.counter, 10) || 0;
         
         // Parse algorithm (SHA1, SHA256, SHA512)
         var algorithmStr = (params.algorithm || 'SHA1').toUpperCase();
@@ -654,7 +662,9 @@ const CONFIG_HTML = `
           secret: secret,
           period: period,
           digits: digits,
-          algorithm: algorithm
+          algorithm: algorithm,
+          type: type,
+          counter: counter
         };
       } catch (err) {
         throw new Error('Invalid otpauth URL: ' + err.message);
@@ -937,12 +947,60 @@ function buildConfigUrl(initialEntries) {
   return 'data:text/html;charset=utf-8,' + encodeURIComponent(htmlWithData);
 }
 
+// Watch sync status codes (AppKeyStatus)
+const SYNC_STATUS_OK = 1;
+const SYNC_STATUS_NO_SPACE = 2;
+const SYNC_STATUS_INVALID = 3;
+
+// Watch-side limits of a stored account
+const WATCH_LABEL_MAX_LEN = 32;
+const WATCH_ACCOUNT_NAME_MAX_LEN = 32;
+const WATCH_SECRET_BYTES_MAX = 64;
+const WATCH_HOTP_COUNTER_BYTES = 8;
+
+let syncRejected = null;  // Why the watch stopped the sync, null while it accepts entries
+
+// Event trace of TRACE builds (AppKeyTrace), sent from System Info with
+// SELECT, not during a sync. Chunks of 8 byte records followed by the event count, logged as
+// base64 for tools/trace_to_chrome.py.
+let traceBytes = [];
+
+function receiveTrace(value) {
+  if (Array.isArray(value)) {
+    traceBytes = traceBytes.concat(value);
+    return;
+  }
+  const binary = String.fromCharCode.apply(null, traceBytes);
+  console.log('TOTPER_TRACE ' + value + ' ' + btoa(binary));
+  traceBytes = [];
+}
+
+function utf8Length(text) {
+  return unescape(encodeURIComponent(text)).length;
+}
+
+// Bytes of label, account name and decoded secret the watch will store,
+// lets it reject a list that doesn't fit before any entry is sent
+function payloadSize(entries) {
+  return entries.reduce((total, entry) => {
+    const fields = entry.split('|').map(field => field.trim());
+    const secret = (fields[2] || '').replace(/=/g, '');
+    return total +
+      Math.min(utf8Length(fields[0] || ''), WATCH_LABEL_MAX_LEN) +
+      Math.min(utf8Length(fields[1] || ''), WATCH_ACCOUNT_NAME_MAX_LEN) +
+      Math.min(Math.floor(secret.length * 5 / 8), WATCH_SECRET_BYTES_MAX) +
+      (fields[6] === '1' ? WATCH_HOTP_COUNTER_BYTES : 0);
+  }, 0);
+}
+
 function sendPayloadToWatch(payload) {
   return new Promise((resolve, reject) => {
     const entries = payload.split(';').filter(entry => entry.trim() !== '');
+    syncRejected = null;
+    traceBytes = [];  // The watch stops a trace dump for the sync
 
     Pebble.sendAppMessage(
-      { AppKeyCount: entries.length },
+      { AppKeyCount: entries.length, AppKeySize: payloadSize(entries) },
       () => {
         const totalCount = entries.length;
 
@@ -952,6 +1010,10 @@ function sendPayloadToWatch(payload) {
         }
 
         function sendNextEntry(index) {
+          if (syncRejected) {
+            reject(syncRejected);
+            return;
+          }
           if (index >= totalCount) {
             resolve();
             return;
@@ -1022,8 +1084,21 @@ Pebble.addEventListener('webviewclosed', e => {
   });
 });
 
-Pebble.addEventListener('appmessage', () => {
-  // Message handling not needed for unidirectional sync
+Pebble.addEventListener('appmessage', e => {
+  if (e && e.payload && e.payload.AppKeyTrace !== undefined) {
+    receiveTrace(e.payload.AppKeyTrace);
+    return;
+  }
+  const status = e && e.payload ? e.payload.AppKeyStatus : undefined;
+  if (status === SYNC_STATUS_NO_SPACE) {
+    syncRejected = 'Not enough storage on the watch';
+    Pebble.showSimpleNotificationOnPebble('TOTPer', 'Not enough storage on the watch for these accounts. Please remove some accounts.');
+  } else if (status === SYNC_STATUS_INVALID) {
+    syncRejected = 'The watch could not read an account';
+    Pebble.showSimpleNotificationOnPebble('TOTPer', 'The watch could not read one of the accounts. Please check the account list.');
+  } else if (status === SYNC_STATUS_OK) {
+    console.log('Accounts synced');
+  }
 });
 
 
@@ -0,0 +1,152 @@
+#!/usr/bin/env python3
+"""Generate resources/images/digits.png, the glyph atlas used to draw codes.
+
+Each glyph is a set of bold strokes along polylines. The strokes are
+rasterized into a 1-bit strip of glyphs in ATLAS_ORDER, each GLYPH_WIDTH x
+GLYPH_HEIGHT pixels. These must match DIGIT_GLYPH_WIDTH and
+DIGIT_GLYPH_HEIGHT in src/c/code_renderer.h and the glyph indices in
+src/c/code_renderer.c. Pass -v to preview the glyphs in the terminal.
+
+Usage: tools/gen_digits.py resources/images/digits.png [-v]
+"""
+import math
+import struct
+import sys
+import zlib
+
+# Glyph cell and atlas layout, see src/c/code_renderer.h and .c
+GLYPH_WIDTH = 15
+GLYPH_HEIGHT = 21
+ATLAS_ORDER = '0123456789-'
+
+# Pen width of the strokes, in pixels
+STROKE_WIDTH = 3.3
+
+# Each pixel is sampled on a SUPERSAMPLE x SUPERSAMPLE grid and inked when
+# at least INK_THRESHOLD of the samples fall on a stroke
+SUPERSAMPLE = 4
+INK_THRESHOLD = 8
+
+# Stroke box inside the glyph cell
+LEFT, RIGHT, TOP, BOTTOM = 1.8, 13.2, 1.8, 19.2
+CENTER_X = 7.5
+
+
+def arc(cx, cy, rx, ry, start_deg, end_deg, segments=48):
+    """Points along an elliptic arc, angles counterclockwise from 3 o'clock."""
+    points = []
+    for i in range(segments + 1):
+        angle = math.radians(start_deg + (end_deg - start_deg) * i / segments)
+        points.append((cx + rx * math.cos(angle), cy - ry * math.sin(angle)))
+    return points
+
+
+def quadratic_bezier(p0, p1, p2, segments=32):
+    """Points along a quadratic Bezier curve from p0 to p2."""
+    points = []
+    for i in range(segments + 1):
+        t = i / segments
+        a, b, c = (1 - t) ** 2, 2 * (1 - t) * t, t * t
+        points.append((a * p0[0] + b * p1[0] + c * p2[0],
+                       a * p0[1] + b * p1[1] + c * p2[1]))
+    return points
+
+
+def rotated(paths):
+    """The same paths turned by 180 degrees within the glyph cell."""
+    return [[(GLYPH_WIDTH - x, GLYPH_HEIGHT - y) for x, y in path] for path in paths]
+
+
+SIX = [
+    arc(CENTER_X, 14.0, 5.4, 5.2, 0, 360),
+    quadratic_bezier((CENTER_X - 5.4, 14.0), (CENTER_X - 5.6, 2.4), (CENTER_X + 4.2, TOP)),
+]
+
+# Stroke paths of each glyph
+GLYPHS = {
+    '0': [arc(CENTER_X, 10.5, 5.6, 8.7, 0, 360)],
+    '1': [[(8.6, TOP), (8.6, BOTTOM)], [(8.6, TOP), (3.6, 5.2)]],
+    '2': [arc(CENTER_X, 6.6, 5.4, 4.8, 165, -25) + [(LEFT + 0.2, BOTTOM)],
+          [(LEFT + 0.2, BOTTOM), (RIGHT, BOTTOM)]],
+    '3': [arc(7.2, 6.0, 5.0, 4.2, 150, -90), arc(7.2, 14.4, 5.7, 4.8, 90, -150)],
+    '4': [[(10.4, TOP), (LEFT, 14.2), (RIGHT, 14.2)], [(10.4, TOP), (10.4, BOTTOM)]],
+    '5': [[(RIGHT - 0.6, TOP), (3.0, TOP), (2.5, 9.6)], arc(7.2, 13.6, 5.8, 5.6, 140, -150)],
+    '6': SIX,
+    '7': [[(LEFT, TOP), (RIGHT, TOP), (5.4, BOTTOM)]],
+    '8': [arc(CENTER_X, 5.8, 4.5, 4.0, 0, 360), arc(CENTER_X, 14.6, 5.6, 4.6, 0, 360)],
+    '9': rotated(SIX),
+    '-': [[(4.0, 11.0), (11.0, 11.0)]],
+}
+
+
+def distance_to_segment(px, py, a, b):
+    ax, ay = a
+    bx, by = b
+    dx, dy = bx - ax, by - ay
+    length_sq = dx * dx + dy * dy
+    t = 0 if length_sq == 0 else max(0, min(1, ((px - ax) * dx + (py - ay) * dy) / length_sq))
+    return math.hypot(px - (ax + t * dx), py - (ay + t * dy))
+
+
+def on_stroke(paths, x, y):
+    for path in paths:
+        for a, b in zip(path, path[1:]):
+            if distance_to_segment(x, y, a, b) <= STROKE_WIDTH / 2:
+                return True
+    return False
+
+
+def render_glyph(char):
+    """Rows of 0/1 pixels, 1 where the glyph is inked."""
+    paths = GLYPHS[char]
+    rows = []
+    for y in range(GLYPH_HEIGHT):
+        row = []
+        for x in range(GLYPH_WIDTH):
+            samples = 0
+            for i in range(SUPERSAMPLE):
+                for j in range(SUPERSAMPLE):
+                    if on_stroke(paths, x + (i + 0.5) / SUPERSAMPLE, y + (j + 0.5) / SUPERSAMPLE):
+                        samples += 1
+            row.append(1 if samples >= INK_THRESHOLD else 0)
+        rows.append(row)
+    return rows
+
+
+def print_preview(glyphs):
+    for y in range(GLYPH_HEIGHT):
+        print(' '.join(''.join('#' if glyph[y][x] else '.' for x in range(GLYPH_WIDTH))
+                       for glyph in glyphs))
+
+
+def png_chunk(chunk_type, data):
+    crc = zlib.crc32(chunk_type + data) & 0xffffffff
+    return struct.pack('>I', len(data)) + chunk_type + data + struct.pack('>I', crc)
+
+
+def encode_atlas(glyphs):
+    """1-bit grayscale PNG of the glyphs side by side, ink is black (0)."""
+    width = GLYPH_WIDTH * len(glyphs)
+    raw = b''
+    for y in range(GLYPH_HEIGHT):
+        bits = [0 if glyphs[x // GLYPH_WIDTH][y][x % GLYPH_WIDTH] else 1 for x in range(width)]
+        bits += [1] * ((8 - len(bits) % 8) % 8)
+        row = bytes(int(''.join(map(str, bits[k:k + 8])), 2) for k in range(0, len(bits), 8))
+        raw += b'\0' + row  # Filter type none
+    header = struct.pack('>IIBBBBB', width, GLYPH_HEIGHT, 1, 0, 0, 0, 0)
+    return (b'\x89PNG\r\n\x1a\n' + png_chunk(b'IHDR', header) +
+            png_chunk(b'IDAT', zlib.compress(raw, 9)) + png_chunk(b'IEND', b''))
+
+
+def main():
+    if len(sys.argv) < 2:
+        sys.exit(__doc__)
+    glyphs = [render_glyph(char) for char in ATLAS_ORDER]
+    if '-v' in sys.argv:
+        print_preview(glyphs)
+    with open(sys.argv[1], 'wb') as output:
+        output.write(encode_atlas(glyphs))
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,98 @@
+#!/usr/bin/env python3
+"""Convert a TOTPer event trace into Chrome trace JSON.
+
+TRACE builds (see src/c/trace.h) send their event ring buffer to the phone
+from the System Info window, where src/pkjs/index.js logs it as a line
+"TOTPER_TRACE <count> <base64>". Save the output of `pebble logs` and
+convert the last trace in it. The result opens in chrome://tracing or
+ui.perfetto.dev.
+
+Usage: tools/trace_to_chrome.py pebble.log trace.json
+"""
+import base64
+import json
+import struct
+import sys
+
+# Prefix of the log line src/pkjs/index.js writes for each trace
+TRACE_MARKER = 'TOTPER_TRACE '
+
+# TraceRecord in src/c/trace.h: time_ms, event, phase, arg, little endian
+RECORD = struct.Struct('<IBBH')
+
+# Names indexed by TraceEvent, TracePhase and TotpAlgorithm
+EVENT_NAMES = ['tick', 'hmac', 'persist_read', 'persist_write', 'message_in', 'message_out']
+PHASE_TYPES = ['B', 'E', 'i']
+ALGORITHM_NAMES = ['sha1', 'sha256', 'sha512']
+
+# Chrome trace instant event, scoped to its thread
+INSTANT = 'i'
+INSTANT_SCOPE = 't'
+
+# The watch is a single process with a single thread
+PID = 1
+TID = 1
+
+
+def last_trace(lines):
+    """Event count and record bytes of the last trace in a log."""
+    fields = None
+    for line in lines:
+        start = line.find(TRACE_MARKER)
+        if start >= 0:
+            fields = line[start:].split()
+    if not fields:
+        sys.exit('no %s line found' % TRACE_MARKER.strip())
+    data = base64.b64decode(fields[2]) if len(fields) > 2 else b''
+    return int(fields[1]), data
+
+
+def event_name(event):
+    return EVENT_NAMES[event] if event < len(EVENT_NAMES) else 'event_%d' % event
+
+
+def event_args(name, arg):
+    """What the arg of an event means, see TraceEvent."""
+    if name == 'hmac':
+        return {'algorithm': ALGORITHM_NAMES[arg] if arg < len(ALGORITHM_NAMES) else arg}
+    if name.startswith('persist'):
+        return {'key': arg}
+    if name == 'message_out':
+        return {'message_key': arg}
+    return {}
+
+
+def convert(data):
+    """Chrome trace events of the whole records in data."""
+    events = []
+    for offset in range(0, len(data) - RECORD.size + 1, RECORD.size):
+        time_ms, event, phase, arg = RECORD.unpack_from(data, offset)
+        name = event_name(event)
+        entry = {
+            'name': name,
+            'ph': PHASE_TYPES[phase] if phase < len(PHASE_TYPES) else INSTANT,
+            'ts': time_ms * 1000,  # Microseconds
+            'pid': PID,
+            'tid': TID,
+            'args': event_args(name, arg),
+        }
+        if entry['ph'] == INSTANT:
+            entry['s'] = INSTANT_SCOPE
+        events.append(entry)
+    return events
+
+
+def main():
+    if len(sys.argv) < 3:
+        sys.exit(__doc__)
+    with open(sys.argv[1], errors='replace') as log:
+        count, data = last_trace(log)
+    events = convert(data)
+    if len(events) != count:
+        print('warning: %d of %d events received' % (len(events), count), file=sys.stderr)
+    with open(sys.argv[2], 'w') as output:
+        json.dump({'traceEvents': events, 'displayTimeUnit': 'ms'}, output, indent=1)
+
+
+if __name__ == '__main__':
+    main()